@@ -49,12 +49,16 @@ XrVector3f operator*(XrVector3f a, float b) {
 static std::uniform_real_distribution<float> pseudorandom_distribution(0, 1.f);
 static std::mt19937 pseudo_random_generator;
 // XR_DOCS_TAG_END_include_algorithm_random
+// Sleeping and CPU time for the idle wait in Run()
+#include <ctime>
+#include <thread>
 
 #define XR_DOCS_CHAPTER_VERSION XR_DOCS_CHAPTER_5_2
 
 class OpenXRTutorial {
 private:
     struct RenderLayerInfo;
+    struct FramePacket;
 
 public:
     OpenXRTutorial(GraphicsAPI_Type apiType)
@@ -64,6 +68,8 @@ public:
             XR_TUT_LOG_ERROR("ERROR: The provided Graphics API is not valid for this platform.");
             DEBUG_BREAK;
         }
+        m_framePipelineEnabled = GetEnv("XR_TUTORIAL_FRAME_PIPELINE") == "1";
+        m_gpuTimingsEnabled = GetEnv("XR_TUTORIAL_GPU_TIMINGS") == "1";
     }
     ~OpenXRTutorial() = default;
 
@@ -119,9 +125,13 @@ public:
             PollSystemEvents();
             PollEvents();
             if (m_sessionRunning) {
+                m_idling = false;
                 RenderFrame();
+            } else {
+                WaitWhileIdle();
             }
         }
+        StopFramePipeline();
 #endif
 
 #if XR_DOCS_CHAPTER_VERSION >= XR_DOCS_CHAPTER_3_1
@@ -538,7 +548,8 @@ private:
 #endif
         } else if (m_apiType == VULKAN) {
 #if defined(XR_USE_GRAPHICS_API_VULKAN)
-            m_graphicsAPI = std::make_unique<GraphicsAPI_Vulkan>(m_xrInstance, m_systemID);
+            // Each view is a separate submission, so allow a whole frame to be recorded while the previous one executes.
+            m_graphicsAPI = std::make_unique<GraphicsAPI_Vulkan>(m_xrInstance, m_systemID, static_cast<uint32_t>(2 * m_viewConfigurationViews.size()));
 #endif
         } else {
             XR_TUT_LOG_ERROR("ERROR: Unknown Graphics API.");
@@ -569,16 +580,18 @@ private:
     }
 
     // XR_DOCS_TAG_BEGIN_CreateResources1
+    // Per-view constants. The per-cuboid model matrix and color are supplied as instance data.
+    // Padded to 256 bytes to satisfy D3D12's constant buffer alignment.
     struct CameraConstants {
         XrMatrix4x4f viewProj;
-        XrMatrix4x4f modelViewProj;
+        XrVector4f pad[12];
+    };
+    CameraConstants cameraConstants;
+    // Per-instance data for one cuboid. The layout matches the instance attributes in VertexShader_Instanced.
+    struct CuboidInstance {
         XrMatrix4x4f model;
         XrVector4f color;
-        XrVector4f pad1;
-        XrVector4f pad2;
-        XrVector4f pad3;
     };
-    CameraConstants cameraConstants;
     XrVector4f normals[6] = {
         {1.00f, 0.00f, 0.00f, 0},
         {-1.00f, 0.00f, 0.00f, 0},
@@ -621,9 +634,9 @@ private:
             30, 31, 32, 33, 34, 35,  // +Z
         };
 
-        m_vertexBuffer = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::VERTEX, sizeof(float) * 4, sizeof(cubeVertices), &cubeVertices});
+        m_vertexBuffer = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::VERTEX, sizeof(float) * 4, sizeof(cubeVertices), &cubeVertices, GraphicsAPI::BufferCreateInfo::Usage::STATIC});
 
-        m_indexBuffer = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::INDEX, sizeof(uint32_t), sizeof(cubeIndices), &cubeIndices});
+        m_indexBuffer = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::INDEX, sizeof(uint32_t), sizeof(cubeIndices), &cubeIndices, GraphicsAPI::BufferCreateInfo::Usage::STATIC});
 
         // XR_DOCS_TAG_BEGIN_Update_numberOfCuboids
         size_t numberOfCuboids = 64 + 2 + 2;
@@ -631,13 +644,19 @@ private:
         // XR_DOCS_TAG_BEGIN_AddHandCuboids
         numberOfCuboids += XR_HAND_JOINT_COUNT_EXT * 2;
         // XR_DOCS_TAG_END_AddHandCuboids
-        m_uniformBuffer_Camera = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::UNIFORM, 0, sizeof(CameraConstants) * numberOfCuboids, nullptr});
-        m_uniformBuffer_Normals = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::UNIFORM, 0, sizeof(normals), &normals});
+        // Leave room for blocks beyond the initial sixty-four.
+        m_maxCuboidCount = numberOfCuboids + m_maxBlockCount;
+        m_cuboidInstances.reserve(m_maxCuboidCount);
+        // The GPU may still be reading the data of earlier submissions, so each one in flight gets its own region.
+        m_framesInFlight = m_graphicsAPI->GetFramesInFlight();
+        m_instanceBuffer = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::VERTEX, sizeof(CuboidInstance), sizeof(CuboidInstance) * m_maxCuboidCount * m_framesInFlight, nullptr, GraphicsAPI::BufferCreateInfo::Usage::STREAM});
+        m_uniformBuffer_Camera = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::UNIFORM, 0, sizeof(CameraConstants) * m_framesInFlight, nullptr, GraphicsAPI::BufferCreateInfo::Usage::STREAM});
+        m_uniformBuffer_Normals = m_graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::UNIFORM, 0, sizeof(normals), &normals, GraphicsAPI::BufferCreateInfo::Usage::STATIC});
         // XR_DOCS_TAG_END_CreateResources1_1
 
         // XR_DOCS_TAG_BEGIN_CreateResources2_OpenGL
         if (m_apiType == OPENGL) {
-            std::string vertexSource = ReadTextFile("VertexShader.glsl");
+            std::string vertexSource = ReadTextFile("VertexShader_Instanced.glsl");
             m_vertexShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
 
             std::string fragmentSource = ReadTextFile("PixelShader.glsl");
@@ -646,7 +665,7 @@ private:
         // XR_DOCS_TAG_END_CreateResources2_OpenGL
         // XR_DOCS_TAG_BEGIN_CreateResources2_VulkanWindowsLinux
         if (m_apiType == VULKAN) {
-            std::vector<char> vertexSource = ReadBinaryFile("VertexShader.spv");
+            std::vector<char> vertexSource = ReadBinaryFile("VertexShader_Instanced.spv");
             m_vertexShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
 
             std::vector<char> fragmentSource = ReadBinaryFile("PixelShader.spv");
@@ -656,7 +675,7 @@ private:
 #if defined(__ANDROID__)
         // XR_DOCS_TAG_BEGIN_CreateResources2_VulkanAndroid
         if (m_apiType == VULKAN) {
-            std::vector<char> vertexSource = ReadBinaryFile("shaders/VertexShader.spv", androidApp->activity->assetManager);
+            std::vector<char> vertexSource = ReadBinaryFile("shaders/VertexShader_Instanced.spv", androidApp->activity->assetManager);
             m_vertexShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
             std::vector<char> fragmentSource = ReadBinaryFile("shaders/PixelShader.spv", androidApp->activity->assetManager);
             m_fragmentShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::FRAGMENT, fragmentSource.data(), fragmentSource.size()});
@@ -664,7 +683,7 @@ private:
         // XR_DOCS_TAG_END_CreateResources2_VulkanAndroid
         // XR_DOCS_TAG_BEGIN_CreateResources2_OpenGLES
         if (m_apiType == OPENGL_ES) {
-            std::string vertexSource = ReadTextFile("shaders/VertexShader_GLES.glsl", androidApp->activity->assetManager);
+            std::string vertexSource = ReadTextFile("shaders/VertexShader_Instanced_GLES.glsl", androidApp->activity->assetManager);
             m_vertexShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
             std::string fragmentSource = ReadTextFile("shaders/PixelShader_GLES.glsl", androidApp->activity->assetManager);
             m_fragmentShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::FRAGMENT, fragmentSource.data(), fragmentSource.size()});
@@ -673,14 +692,14 @@ private:
 #endif
         // XR_DOCS_TAG_BEGIN_CreateResources2_D3D
         if (m_apiType == D3D11) {
-            std::vector<char> vertexSource = ReadBinaryFile("VertexShader_5_0.cso");
+            std::vector<char> vertexSource = ReadBinaryFile("VertexShader_Instanced_5_0.cso");
             m_vertexShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
 
             std::vector<char> fragmentSource = ReadBinaryFile("PixelShader_5_0.cso");
             m_fragmentShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::FRAGMENT, fragmentSource.data(), fragmentSource.size()});
         }
         if (m_apiType == D3D12) {
-            std::vector<char> vertexSource = ReadBinaryFile("VertexShader_5_1.cso");
+            std::vector<char> vertexSource = ReadBinaryFile("VertexShader_Instanced_5_1.cso");
             m_vertexShader = m_graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
 
             std::vector<char> fragmentSource = ReadBinaryFile("PixelShader_5_1.cso");
@@ -691,8 +710,14 @@ private:
         // XR_DOCS_TAG_BEGIN_CreateResources3
         GraphicsAPI::PipelineCreateInfo pipelineCI;
         pipelineCI.shaders = {m_vertexShader, m_fragmentShader};
-        pipelineCI.vertexInputState.attributes = {{0, 0, GraphicsAPI::VertexType::VEC4, 0, "TEXCOORD"}};
-        pipelineCI.vertexInputState.bindings = {{0, 0, 4 * sizeof(float)}};
+        pipelineCI.vertexInputState.attributes = {{0, 0, GraphicsAPI::VertexType::VEC4, 0, "TEXCOORD"},
+                                                  {1, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 0 * sizeof(XrVector4f), "TEXCOORD"},
+                                                  {2, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 1 * sizeof(XrVector4f), "TEXCOORD"},
+                                                  {3, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 2 * sizeof(XrVector4f), "TEXCOORD"},
+                                                  {4, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 3 * sizeof(XrVector4f), "TEXCOORD"},
+                                                  {5, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, color), "TEXCOORD"}};
+        pipelineCI.vertexInputState.bindings = {{0, 0, 4 * sizeof(float), GraphicsAPI::VertexInputRate::PER_VERTEX},
+                                                {1, 0, sizeof(CuboidInstance), GraphicsAPI::VertexInputRate::PER_INSTANCE}};
         pipelineCI.inputAssemblyState = {GraphicsAPI::PrimitiveTopology::TRIANGLE_LIST, false};
         pipelineCI.rasterisationState = {false, false, GraphicsAPI::PolygonMode::FILL, GraphicsAPI::CullMode::BACK, GraphicsAPI::FrontFace::COUNTER_CLOCKWISE, false, 0.0f, 0.0f, 0.0f, 1.0f};
         pipelineCI.multisampleState = {1, false, 1.0f, 0xFFFFFFFF, false, false};
@@ -700,10 +725,12 @@ private:
         pipelineCI.colorBlendState = {false, GraphicsAPI::LogicOp::NO_OP, {{true, GraphicsAPI::BlendFactor::SRC_ALPHA, GraphicsAPI::BlendFactor::ONE_MINUS_SRC_ALPHA, GraphicsAPI::BlendOp::ADD, GraphicsAPI::BlendFactor::ONE, GraphicsAPI::BlendFactor::ZERO, GraphicsAPI::BlendOp::ADD, (GraphicsAPI::ColorComponentBit)15}}, {0.0f, 0.0f, 0.0f, 0.0f}};
         pipelineCI.colorFormats = {m_colorSwapchainInfos[0].swapchainFormat};
         pipelineCI.depthFormat = m_depthSwapchainInfos[0].swapchainFormat;
-        pipelineCI.layout = {{0, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX},
+        pipelineCI.layout = {{0, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, 0, sizeof(CameraConstants), true},
                              {1, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX},
                              {2, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::FRAGMENT}};
-        m_pipeline = m_graphicsAPI->CreatePipeline(pipelineCI);
+        // Compilation continues in the background while the blocks are set up and the session starts. Frames rendered
+        // before the pipeline is ready are cleared but skip the cuboids.
+        m_pipeline = m_graphicsAPI->CreatePipelineAsync(pipelineCI);
         // XR_DOCS_TAG_END_CreateResources3
 
         // XR_DOCS_TAG_BEGIN_Setup_Blocks
@@ -728,6 +755,16 @@ private:
             }
         }
         // XR_DOCS_TAG_END_Setup_Blocks
+        for (int j = 0; j < m_blocks.size(); j++) {
+            InsertBlockIntoGrid(j);
+        }
+
+        if (GetEnv("XR_TUTORIAL_LATE_LATCH") == "1") {
+            m_lateLatchEnabled = m_graphicsAPI->DefersCommandExecution();
+            if (!m_lateLatchEnabled) {
+                XR_TUT_LOG("Late latching is not supported by this graphics API, as it may execute draws before EndRendering().");
+            }
+        }
     }
     void DestroyResources() {
         // XR_DOCS_TAG_BEGIN_DestroyResources
@@ -736,6 +773,7 @@ private:
         m_graphicsAPI->DestroyShader(m_vertexShader);
         m_graphicsAPI->DestroyBuffer(m_uniformBuffer_Camera);
         m_graphicsAPI->DestroyBuffer(m_uniformBuffer_Normals);
+        m_graphicsAPI->DestroyBuffer(m_instanceBuffer);
         m_graphicsAPI->DestroyBuffer(m_indexBuffer);
         m_graphicsAPI->DestroyBuffer(m_vertexBuffer);
         // XR_DOCS_TAG_END_DestroyResources
@@ -806,6 +844,7 @@ private:
                 }
                 if (sessionStateChanged->state == XR_SESSION_STATE_STOPPING) {
                     // SessionState is stopping. End the XrSession.
+                    StopFramePipeline();
                     OPENXR_CHECK(xrEndSession(m_session), "Failed to end Session.");
                     m_sessionRunning = false;
                 }
@@ -831,6 +870,81 @@ private:
         }
         // XR_DOCS_TAG_END_PollEvents
     }
+    static double GetProcessCpuSeconds() {
+#if defined(_WIN32)
+        // MSVC's std::clock() measures wall time, not CPU time.
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+            return 0.0;
+        }
+        auto toSeconds = [](const FILETIME &time) { return double((uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7; };
+        return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+        return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+    }
+
+    void CollectGpuTimings() {
+        // Results arrive a few frames late, in the order their scopes were opened. Nested scopes are named by their path,
+        // e.g. "View 0/Cuboids", so that each view and pass is averaged separately.
+        std::vector<std::string> scopePath;
+        for (const GraphicsAPI::TimestampScopeResult &result : m_graphicsAPI->GetTimestampScopeResults()) {
+            scopePath.resize(result.depth);
+            scopePath.push_back(result.name);
+            std::string name;
+            for (const std::string &scopeName : scopePath) {
+                name += (name.empty() ? "" : "/") + scopeName;
+            }
+            std::pair<double, uint32_t> &gpuTiming = m_gpuTimings[name];
+            gpuTiming.first += result.milliseconds;
+            gpuTiming.second++;
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (m_gpuTimingPeriodStart == std::chrono::steady_clock::time_point()) {
+            m_gpuTimingPeriodStart = now;
+        }
+        if (m_gpuTimings.empty() || std::chrono::duration<double>(now - m_gpuTimingPeriodStart).count() < 10.0) {
+            return;
+        }
+        for (const auto &gpuTiming : m_gpuTimings) {
+            XR_TUT_LOG("GPU: " << gpuTiming.first << ": " << gpuTiming.second.first / gpuTiming.second.second << " ms average over " << gpuTiming.second.second << " submissions.");
+        }
+        m_gpuTimings.clear();
+        m_gpuTimingPeriodStart = now;
+    }
+
+    void WaitWhileIdle() {
+        // xrPollEvent() doesn't block, so while the session isn't running (not yet READY, IDLE or STOPPING) the loop in Run()
+        // would spin a whole core. Sleep instead, doubling the sleep up to a bound and restarting from the shortest sleep
+        // whenever the session state changes, so that a READY session is still begun promptly.
+        const std::chrono::milliseconds minIdleSleep(1);
+        const std::chrono::milliseconds maxIdleSleep(100);
+        if (!m_idling) {
+            m_idling = true;
+            m_idlePeriodStart = std::chrono::steady_clock::now();
+            m_idlePeriodCpuSeconds = GetProcessCpuSeconds();
+            m_idleSessionState = m_sessionState;
+            m_idleSleep = minIdleSleep;
+        } else if (m_idleSessionState != m_sessionState) {
+            m_idleSessionState = m_sessionState;
+            m_idleSleep = minIdleSleep;
+        } else {
+            m_idleSleep = std::min(m_idleSleep * 2, maxIdleSleep);
+        }
+        std::this_thread::sleep_for(m_idleSleep);
+
+        // Periodically report the CPU usage of the whole process while idle.
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double periodSeconds = std::chrono::duration<double>(now - m_idlePeriodStart).count();
+        if (periodSeconds >= 10.0) {
+            double cpuSeconds = GetProcessCpuSeconds() - m_idlePeriodCpuSeconds;
+            XR_TUT_LOG("Idle: " << 100.0 * cpuSeconds / periodSeconds << "% CPU over " << periodSeconds << " s while the session state was " << m_sessionState << ".");
+            m_idlePeriodStart = now;
+            m_idlePeriodCpuSeconds = GetProcessCpuSeconds();
+        }
+    }
+
     // XR_DOCS_TAG_BEGIN_PollActions
     void PollActions(XrTime predictedTime) {
         // Update our action set with up-to-date input data.
@@ -927,6 +1041,48 @@ private:
         pos.z = float(z) / 10.f;
         return pos;
     }
+    // The blocks are indexed by the 10cm cell that FixPosition() snaps them to. A block within 10cm of a hand is at most
+    // one cell away from the hand's cell on each axis, so BlockInteraction() only has to look at 27 cells.
+    static void GetBlockGridCell(const XrVector3f &pos, int32_t cell[3]) {
+        cell[0] = int32_t(std::nearbyint(pos.x * 10.f));
+        cell[1] = int32_t(std::nearbyint(pos.y * 10.f));
+        cell[2] = int32_t(std::nearbyint(pos.z * 10.f));
+    }
+    static int64_t GetBlockGridKey(int32_t x, int32_t y, int32_t z) {
+        // 21 bits per axis covers +/-100km at 10cm.
+        const int64_t mask = (int64_t(1) << 21) - 1;
+        return ((int64_t(x) & mask) << 42) | ((int64_t(y) & mask) << 21) | (int64_t(z) & mask);
+    }
+    void InsertBlockIntoGrid(int block) {
+        int32_t cell[3];
+        GetBlockGridCell(m_blocks[block].pose.position, cell);
+        int64_t key = GetBlockGridKey(cell[0], cell[1], cell[2]);
+        if (m_blockGridKeys.size() <= static_cast<size_t>(block)) {
+            m_blockGridKeys.resize(block + 1);
+        }
+        m_blockGridKeys[block] = key;
+        m_blockGrid[key].push_back(block);
+    }
+    void RemoveBlockFromGrid(int block) {
+        auto it = m_blockGrid.find(m_blockGridKeys[block]);
+        if (it == m_blockGrid.end()) {
+            return;
+        }
+        std::vector<int> &cellBlocks = it->second;
+        cellBlocks.erase(std::remove(cellBlocks.begin(), cellBlocks.end(), block), cellBlocks.end());
+        if (cellBlocks.empty()) {
+            m_blockGrid.erase(it);
+        }
+    }
+    // Call after moving a block. Only touches the grid if the block has changed cell.
+    void UpdateBlockInGrid(int block) {
+        int32_t cell[3];
+        GetBlockGridCell(m_blocks[block].pose.position, cell);
+        if (GetBlockGridKey(cell[0], cell[1], cell[2]) != m_blockGridKeys[block]) {
+            RemoveBlockFromGrid(block);
+            InsertBlockIntoGrid(block);
+        }
+    }
     // Handle the interaction between the user's hands, the grab action, and the 3D blocks.
     void BlockInteraction() {
         // For each hand:
@@ -937,15 +1093,28 @@ private:
                 m_nearBlock[i] = -1;
                 // Only if the pose was detected this frame:
                 if (m_handPoseState[i].isActive) {
-                    // For each block:
-                    for (int j = 0; j < m_blocks.size(); j++) {
-                        auto block = m_blocks[j];
-                        // How far is it from the hand to this block?
-                        XrVector3f diff = block.pose.position - m_handPose[i].position;
-                        float distance = std::max(fabs(diff.x), std::max(fabs(diff.y), fabs(diff.z)));
-                        if (distance < 0.1f && distance < nearest) {
-                            m_nearBlock[i] = j;
-                            nearest = distance;
+                    // For each block in the cells around the hand:
+                    int32_t cell[3];
+                    GetBlockGridCell(m_handPose[i].position, cell);
+                    for (int32_t dx = -1; dx <= 1; dx++) {
+                        for (int32_t dy = -1; dy <= 1; dy++) {
+                            for (int32_t dz = -1; dz <= 1; dz++) {
+                                auto it = m_blockGrid.find(GetBlockGridKey(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+                                if (it == m_blockGrid.end()) {
+                                    continue;
+                                }
+                                for (int j : it->second) {
+                                    const Block &block = m_blocks[j];
+                                    // How far is it from the hand to this block?
+                                    XrVector3f diff = block.pose.position - m_handPose[i].position;
+                                    float distance = std::max(fabs(diff.x), std::max(fabs(diff.y), fabs(diff.z)));
+                                    // On a tie, prefer the lower index, as a scan of all the blocks would.
+                                    if (distance < 0.1f && (distance < nearest || (distance == nearest && j < m_nearBlock[i]))) {
+                                        m_nearBlock[i] = j;
+                                        nearest = distance;
+                                    }
+                                }
+                            }
                         }
                     }
                 }
@@ -961,10 +1130,13 @@ private:
                 }
             } else {
                 m_nearBlock[i] = m_grabbedBlock[i];
-                if (m_handPoseState[i].isActive)
+                if (m_handPoseState[i].isActive) {
                     m_blocks[m_grabbedBlock[i]].pose.position = m_handPose[i].position;
+                    UpdateBlockInGrid(m_grabbedBlock[i]);
+                }
                 if (!m_grabState[i].isActive || m_grabState[i].currentState < 0.5f) {
                     m_blocks[m_grabbedBlock[i]].pose.position = FixPosition(m_blocks[m_grabbedBlock[i]].pose.position);
+                    UpdateBlockInGrid(m_grabbedBlock[i]);
                     m_grabbedBlock[i] = -1;
                     m_buzz[i] = 0.2f;
                 }
@@ -1116,39 +1288,381 @@ private:
     }
 
     // XR_DOCS_TAG_BEGIN_RenderCuboid1
-    size_t renderCuboidIndex = 0;
+    // Cuboids queued by RenderCuboid() for the frame being simulated.
+    std::vector<CuboidInstance> m_cuboidInstances;
     // XR_DOCS_TAG_END_RenderCuboid1
     void RenderCuboid(XrPosef pose, XrVector3f scale, XrVector3f color) {
         // XR_DOCS_TAG_BEGIN_RenderCuboid2
-        XrMatrix4x4f_CreateTranslationRotationScale(&cameraConstants.model, &pose.position, &pose.orientation, &scale);
+        // Only record the instance data here. All queued cuboids are drawn together by DrawCuboids().
+        CuboidInstance instance;
+        XrMatrix4x4f_CreateTranslationRotationScale(&instance.model, &pose.position, &pose.orientation, &scale);
+        instance.color = {color.x, color.y, color.z, 1.0f};
+        m_cuboidInstances.push_back(instance);
+        // XR_DOCS_TAG_END_RenderCuboid2
+    }
 
-        XrMatrix4x4f_Multiply(&cameraConstants.modelViewProj, &cameraConstants.viewProj, &cameraConstants.model);
-        cameraConstants.color = {color.x, color.y, color.z, 1.0};
-        size_t offsetCameraUB = sizeof(CameraConstants) * renderCuboidIndex;
+    // The frame's cuboid instances, uploaded once by UploadCuboids() and drawn by every view.
+    struct CuboidFrameInfo {
+        uint32_t firstInstance = 0;
+        uint32_t instanceCount = 0;
+    };
+
+    // Model matrices and colors don't depend on the view, so the frame's instance data is uploaded once, during the
+    // first view's submission, rather than once per view.
+    CuboidFrameInfo UploadCuboids(const std::vector<CuboidInstance> &cuboidInstances) {
+        if (cuboidInstances.empty()) {
+            return {};
+        }
+        if (cuboidInstances.size() > m_maxCuboidCount) {
+            XR_TUT_LOG_ERROR("Too many cuboids queued: " << cuboidInstances.size() << ". Only the first " << m_maxCuboidCount << " will be drawn.");
+        }
+        uint32_t instanceCount = static_cast<uint32_t>(std::min(cuboidInstances.size(), m_maxCuboidCount));
+
+        // Cycle through the regions reserved for submissions in flight. Each frame's region is read by one submission
+        // per view, so there are always enough regions.
+        size_t region = m_cuboidFrameIndex++ % m_framesInFlight;
+        uint32_t firstInstance = static_cast<uint32_t>(m_maxCuboidCount * region);
+        m_graphicsAPI->SetBufferData(m_instanceBuffer, sizeof(CuboidInstance) * firstInstance, sizeof(CuboidInstance) * instanceCount, (void *)cuboidInstances.data());
+        return {firstInstance, instanceCount};
+    }
+
+    // Where DrawCuboids() put a view's camera constants and which instances it drew, see LateLatchView().
+    struct CuboidDrawInfo {
+        GraphicsAPI::TransientBufferAllocation camera = {nullptr, 0, nullptr};
+        uint32_t firstInstance = 0;
+        uint32_t instanceCount = 0;
+    };
+
+    CuboidDrawInfo DrawCuboids(const CuboidFrameInfo &cuboidFrame) {
+        if (cuboidFrame.instanceCount == 0 || !m_graphicsAPI->IsPipelineReady(m_pipeline)) {
+            return {};
+        }
+
+        // DrawCuboids() is called once per submission; cycle through the regions reserved for submissions in flight.
+        size_t region = m_cuboidDrawIndex++ % m_framesInFlight;
+        size_t offsetCameraUB = sizeof(CameraConstants) * region;
 
         m_graphicsAPI->SetPipeline(m_pipeline);
 
-        m_graphicsAPI->SetBufferData(m_uniformBuffer_Camera, offsetCameraUB, sizeof(CameraConstants), &cameraConstants);
-        m_graphicsAPI->SetDescriptor({0, m_uniformBuffer_Camera, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, offsetCameraUB, sizeof(CameraConstants)});
+        // Only the view's constants are uploaded here; the instances were uploaded for the whole frame by UploadCuboids().
+        // Prefer the API's transient uniform allocator, which is a plain write into persistently mapped memory.
+        GraphicsAPI::TransientBufferAllocation cameraAllocation = m_graphicsAPI->AllocateTransientUniformData(sizeof(CameraConstants));
+        if (cameraAllocation.data) {
+            memcpy(cameraAllocation.data, &cameraConstants, sizeof(CameraConstants));
+        } else {
+            cameraAllocation = {m_uniformBuffer_Camera, offsetCameraUB, nullptr};
+            m_graphicsAPI->SetBufferData(m_uniformBuffer_Camera, offsetCameraUB, sizeof(CameraConstants), &cameraConstants);
+        }
+        m_graphicsAPI->SetDescriptor({0, cameraAllocation.buffer, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, cameraAllocation.offset, sizeof(CameraConstants), true});
         m_graphicsAPI->SetDescriptor({1, m_uniformBuffer_Normals, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, 0, sizeof(normals)});
 
         m_graphicsAPI->UpdateDescriptors();
 
-        m_graphicsAPI->SetVertexBuffers(&m_vertexBuffer, 1);
+        void *vertexBuffers[] = {m_vertexBuffer, m_instanceBuffer};
+        m_graphicsAPI->SetVertexBuffers(vertexBuffers, 2);
         m_graphicsAPI->SetIndexBuffer(m_indexBuffer);
-        m_graphicsAPI->DrawIndexed(36);
+        m_graphicsAPI->DrawIndexed(36, cuboidFrame.instanceCount, 0, 0, cuboidFrame.firstInstance);
+        return {cameraAllocation, cuboidFrame.firstInstance, cuboidFrame.instanceCount};
+    }
 
-        renderCuboidIndex++;
-        // XR_DOCS_TAG_END_RenderCuboid2
+    XrMatrix4x4f CreateViewProjection(const XrView &xrView, float nearZ, float farZ) {
+        // All matrices (including OpenXR's) are column-major, right-handed.
+        XrMatrix4x4f proj;
+        XrMatrix4x4f_CreateProjectionFov(&proj, m_apiType, xrView.fov, nearZ, farZ);
+        XrMatrix4x4f toView;
+        XrVector3f scale1m{1.0f, 1.0f, 1.0f};
+        XrMatrix4x4f_CreateTranslationRotationScale(&toView, &xrView.pose.position, &xrView.pose.orientation, &scale1m);
+        XrMatrix4x4f view;
+        XrMatrix4x4f_InvertRigidBody(&view, &toView);
+        XrMatrix4x4f viewProj;
+        XrMatrix4x4f_Multiply(&viewProj, &proj, &view);
+        return viewProj;
+    }
+
+    // The cuboids that CullCuboids() kept this frame, with the controllers' indices remapped for LateLatchView().
+    struct VisibleCuboids {
+        std::vector<CuboidInstance> instances;
+        int32_t controllerInstances[2] = {-1, -1};
+        uint32_t culledCount = 0;
+    };
+
+    // Builds one frustum that contains every view's frustum, so each cuboid is tested once per frame rather than once per
+    // view. The union of the fovs is placed at the views' centroid, pushed back far enough to enclose each view's offset.
+    // Returns false if the views aren't parallel (e.g. canted displays) or the fovs can't enclose the offsets.
+    bool CreateCombinedViewProjection(const std::vector<XrView> &views, uint32_t viewCount, float fovMargin, float nearZ, float farZ, XrMatrix4x4f &viewProj) {
+        XrView combinedView{XR_TYPE_VIEW};
+        combinedView.pose = views[0].pose;
+        combinedView.fov = views[0].fov;
+        XrVector3f centroid = {0.0f, 0.0f, 0.0f};
+        for (uint32_t i = 0; i < viewCount; i++) {
+            const XrQuaternionf &a = views[0].pose.orientation;
+            const XrQuaternionf &b = views[i].pose.orientation;
+            if (fabsf(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w) < 0.9999f) {
+                return false;
+            }
+            combinedView.fov.angleLeft = std::min(combinedView.fov.angleLeft, views[i].fov.angleLeft);
+            combinedView.fov.angleRight = std::max(combinedView.fov.angleRight, views[i].fov.angleRight);
+            combinedView.fov.angleDown = std::min(combinedView.fov.angleDown, views[i].fov.angleDown);
+            combinedView.fov.angleUp = std::max(combinedView.fov.angleUp, views[i].fov.angleUp);
+            XrVector3f_Add(&centroid, &centroid, &views[i].pose.position);
+        }
+        XrVector3f_Scale(&centroid, &centroid, 1.0f / static_cast<float>(viewCount));
+
+        const float maxAngle = 1.5f;  // Keep the tangents finite.
+        combinedView.fov.angleLeft = std::max(combinedView.fov.angleLeft - fovMargin, -maxAngle);
+        combinedView.fov.angleRight = std::min(combinedView.fov.angleRight + fovMargin, maxAngle);
+        combinedView.fov.angleDown = std::max(combinedView.fov.angleDown - fovMargin, -maxAngle);
+        combinedView.fov.angleUp = std::min(combinedView.fov.angleUp + fovMargin, maxAngle);
+
+        // The views' offsets from the centroid, in the views' local space.
+        XrMatrix4x4f rotation;
+        XrMatrix4x4f_CreateFromQuaternion(&rotation, &combinedView.pose.orientation);
+        XrVector3f extents = {0.0f, 0.0f, 0.0f};
+        for (uint32_t i = 0; i < viewCount; i++) {
+            XrVector3f offset;
+            XrVector3f_Sub(&offset, &views[i].pose.position, &centroid);
+            extents.x = std::max(extents.x, fabsf(rotation.m[0] * offset.x + rotation.m[1] * offset.y + rotation.m[2] * offset.z));
+            extents.y = std::max(extents.y, fabsf(rotation.m[4] * offset.x + rotation.m[5] * offset.y + rotation.m[6] * offset.z));
+            extents.z = std::max(extents.z, fabsf(rotation.m[8] * offset.x + rotation.m[9] * offset.y + rotation.m[10] * offset.z));
+        }
+
+        // A view offset sideways by e stays inside the combined frustum if its apex is at least e / tan(angle) behind it.
+        const float tanLeft = tanf(combinedView.fov.angleLeft);
+        const float tanRight = tanf(combinedView.fov.angleRight);
+        const float tanDown = tanf(combinedView.fov.angleDown);
+        const float tanUp = tanf(combinedView.fov.angleUp);
+        const float epsilon = 1e-6f;
+        if ((extents.x > epsilon && (tanLeft >= -epsilon || tanRight <= epsilon)) || (extents.y > epsilon && (tanDown >= -epsilon || tanUp <= epsilon))) {
+            return false;
+        }
+        float backOffset = extents.z;
+        if (extents.x > epsilon) {
+            backOffset += std::max(extents.x / -tanLeft, extents.x / tanRight);
+        }
+        if (extents.y > epsilon) {
+            backOffset = std::max(backOffset, extents.z + std::max(extents.y / -tanDown, extents.y / tanUp));
+        }
+
+        // OpenXR views look down -Z, so the apex moves back along +Z.
+        combinedView.pose.position = {centroid.x + rotation.m[8] * backOffset, centroid.y + rotation.m[9] * backOffset, centroid.z + rotation.m[10] * backOffset};
+        viewProj = CreateViewProjection(combinedView, nearZ, farZ + backOffset + extents.z);
+        return true;
+    }
+
+    // Keeps only the cuboids that are visible in at least one view. The controllers are always kept, as LateLatchView()
+    // may move them after culling.
+    void CullCuboids(const FramePacket &framePacket, const std::vector<XrView> &views, uint32_t viewCount, float nearZ, float farZ) {
+        VisibleCuboids &visibleCuboids = m_visibleCuboids;
+        visibleCuboids.instances.clear();
+        visibleCuboids.controllerInstances[0] = -1;
+        visibleCuboids.controllerInstances[1] = -1;
+        visibleCuboids.culledCount = 0;
+        if (viewCount == 0) {
+            return;
+        }
+
+        // Late latching can turn the head after culling, so leave some room at the edges.
+        const float fovMargin = m_lateLatchEnabled ? 0.05f : 0.0f;
+        std::vector<XrMatrix4x4f> frustums(1);
+        if (!CreateCombinedViewProjection(views, viewCount, fovMargin, nearZ, farZ, frustums[0])) {
+            frustums.resize(viewCount);
+            for (uint32_t i = 0; i < viewCount; i++) {
+                XrView view = views[i];
+                view.fov.angleLeft -= fovMargin;
+                view.fov.angleRight += fovMargin;
+                view.fov.angleDown -= fovMargin;
+                view.fov.angleUp += fovMargin;
+                frustums[i] = CreateViewProjection(view, nearZ, farZ);
+            }
+        }
+
+        // The cuboid's vertices span -0.5 to +0.5 on each axis before the model transform.
+        const XrVector3f cuboidMins = {-0.5f, -0.5f, -0.5f};
+        const XrVector3f cuboidMaxs = {+0.5f, +0.5f, +0.5f};
+        for (size_t i = 0; i < framePacket.cuboidInstances.size(); i++) {
+            const CuboidInstance &cuboid = framePacket.cuboidInstances[i];
+            int32_t controller = -1;
+            for (int j = 0; j < 2; j++) {
+                if (framePacket.controllerInstances[j] == static_cast<int32_t>(i)) {
+                    controller = j;
+                }
+            }
+
+            bool visible = controller >= 0;
+            if (!visible) {
+                XrVector3f mins;
+                XrVector3f maxs;
+                XrMatrix4x4f_TransformBounds(&mins, &maxs, &cuboid.model, &cuboidMins, &cuboidMaxs);
+                for (const XrMatrix4x4f &frustum : frustums) {
+                    if (!XrMatrix4x4f_CullBounds(&frustum, &mins, &maxs)) {
+                        visible = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!visible) {
+                visibleCuboids.culledCount++;
+                continue;
+            }
+            if (controller >= 0) {
+                visibleCuboids.controllerInstances[controller] = static_cast<int32_t>(visibleCuboids.instances.size());
+            }
+            visibleCuboids.instances.push_back(cuboid);
+        }
+
+        ReportCullingStats(static_cast<uint32_t>(visibleCuboids.instances.size()), visibleCuboids.culledCount);
+    }
+
+    void ReportCullingStats(uint32_t drawnCount, uint32_t culledCount) {
+        m_cullingStats.drawn += drawnCount;
+        m_cullingStats.culled += culledCount;
+        m_cullingStats.frames++;
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (m_cullingStats.periodStart == std::chrono::steady_clock::time_point()) {
+            m_cullingStats.periodStart = now;
+        }
+        if (std::chrono::duration<double>(now - m_cullingStats.periodStart).count() < 10.0) {
+            return;
+        }
+        if (GetEnv("XR_TUTORIAL_CULLING_STATS") == "1") {
+            XR_TUT_LOG("Culling: " << drawnCount << " cuboids drawn, " << culledCount << " culled in the last frame; "
+                                   << static_cast<double>(m_cullingStats.drawn) / m_cullingStats.frames << " drawn, "
+                                   << static_cast<double>(m_cullingStats.culled) / m_cullingStats.frames << " culled per frame on average over " << m_cullingStats.frames << " frames.");
+        }
+        m_cullingStats = {};
+        m_cullingStats.periodStart = now;
+    }
+
+    // Controller poses located by LateLatchView(), once per frame so that both eyes see the controllers in the same place.
+    // Their instances are shared by every view, so they're rewritten before the first view's submission only.
+    struct LateLatchedControllers {
+        bool located = false;
+        bool valid[2] = {false, false};
+        XrPosef pose[2];
+    };
+
+    // With XR_TUTORIAL_LATE_LATCH=1, called after a view's draws are recorded and just before EndRendering() submits
+    // them. Locates the view and the controllers again and rewrites the camera constants and the controller instances
+    // that the draws read, which is only possible if the API defers execution, see DefersCommandExecution().
+    // The layer's pose and fov are updated to match what is rendered.
+    void LateLatchView(uint32_t viewIndex, RenderLayerInfo &renderLayerInfo, const VisibleCuboids &visibleCuboids, const CuboidDrawInfo &cuboidDraw, LateLatchedControllers &controllers, float nearZ, float farZ) {
+        if (cuboidDraw.instanceCount == 0) {
+            return;
+        }
+
+        std::vector<XrView> views(m_viewConfigurationViews.size(), {XR_TYPE_VIEW});
+        XrViewState viewState{XR_TYPE_VIEW_STATE};
+        XrViewLocateInfo viewLocateInfo{XR_TYPE_VIEW_LOCATE_INFO};
+        viewLocateInfo.viewConfigurationType = m_viewConfiguration;
+        viewLocateInfo.displayTime = renderLayerInfo.predictedDisplayTime;
+        viewLocateInfo.space = m_localSpace;
+        uint32_t viewCount = 0;
+        XrResult result = xrLocateViews(m_session, &viewLocateInfo, &viewState, static_cast<uint32_t>(views.size()), &viewCount, views.data());
+        const XrViewStateFlags poseValid = XR_VIEW_STATE_POSITION_VALID_BIT | XR_VIEW_STATE_ORIENTATION_VALID_BIT;
+        if (result == XR_SUCCESS && viewIndex < viewCount && (viewState.viewStateFlags & poseValid) == poseValid) {
+            CameraConstants latchedCameraConstants = cameraConstants;
+            latchedCameraConstants.viewProj = CreateViewProjection(views[viewIndex], nearZ, farZ);
+            if (cuboidDraw.camera.data) {
+                memcpy(cuboidDraw.camera.data, &latchedCameraConstants, sizeof(CameraConstants));
+            } else {
+                m_graphicsAPI->SetBufferData(cuboidDraw.camera.buffer, cuboidDraw.camera.offset, sizeof(CameraConstants), &latchedCameraConstants);
+            }
+            renderLayerInfo.layerProjectionViews[viewIndex].pose = views[viewIndex].pose;
+            renderLayerInfo.layerProjectionViews[viewIndex].fov = views[viewIndex].fov;
+        }
+
+        for (int i = 0; i < 2 && !controllers.located; i++) {
+            int32_t instance = visibleCuboids.controllerInstances[i];
+            if (instance < 0 || static_cast<uint32_t>(instance) >= cuboidDraw.instanceCount) {
+                continue;
+            }
+            XrSpaceLocation spaceLocation{XR_TYPE_SPACE_LOCATION};
+            XrResult res = xrLocateSpace(m_handPoseSpace[i], m_localSpace, renderLayerInfo.predictedDisplayTime, &spaceLocation);
+            controllers.valid[i] = XR_UNQUALIFIED_SUCCESS(res) &&
+                                   (spaceLocation.locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 &&
+                                   (spaceLocation.locationFlags & XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0;
+            controllers.pose[i] = spaceLocation.pose;
+            if (controllers.valid[i]) {
+                CuboidInstance cuboid = visibleCuboids.instances[instance];
+                XrMatrix4x4f_CreateTranslationRotationScale(&cuboid.model, &controllers.pose[i].position, &controllers.pose[i].orientation, &m_controllerCuboidScale);
+                m_graphicsAPI->SetBufferData(m_instanceBuffer, sizeof(CuboidInstance) * (cuboidDraw.firstInstance + instance), sizeof(CuboidInstance), &cuboid);
+            }
+        }
+        controllers.located = true;
     }
 
     void RenderFrame() {
 #if XR_DOCS_CHAPTER_VERSION >= XR_DOCS_CHAPTER_3_2
+        if (m_framePipelineEnabled) {
+            RenderPipelinedFrame();
+            return;
+        }
         // XR_DOCS_TAG_BEGIN_RenderFrame
         // Get the XrFrameState for timing and rendering info.
-        XrFrameState frameState{XR_TYPE_FRAME_STATE};
+        FramePacket framePacket;
         XrFrameWaitInfo frameWaitInfo{XR_TYPE_FRAME_WAIT_INFO};
-        OPENXR_CHECK(xrWaitFrame(m_session, &frameWaitInfo, &frameState), "Failed to wait for XR Frame.");
+        OPENXR_CHECK(xrWaitFrame(m_session, &frameWaitInfo, &framePacket.frameState), "Failed to wait for XR Frame.");
+
+        // Simulate and render the frame on this thread, between xrBeginFrame() and xrEndFrame().
+        SubmitFrame(framePacket, true);
+        // XR_DOCS_TAG_END_RenderFrame
+#endif
+    }
+
+    // Simulation stage: input and interaction for the frame, then the cuboids that make up the scene.
+    void SimulateFrame(FramePacket &framePacket) {
+        m_cuboidInstances.clear();
+        framePacket.controllerInstances[0] = framePacket.controllerInstances[1] = -1;
+        if (framePacket.frameState.shouldRender) {
+            // poll actions here because they require a predicted display time, which we've only just obtained.
+            PollActions(framePacket.frameState.predictedDisplayTime);
+            // Handle the interaction between the user and the 3D blocks.
+            BlockInteraction();
+
+            // Draw a floor. Scale it by 2 in the X and Z, and 0.1 in the Y,
+            RenderCuboid({{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, -m_viewHeightM, 0.0f}}, {2.0f, 0.1f, 2.0f}, {0.4f, 0.5f, 0.5f});
+            // Draw a "table".
+            RenderCuboid({{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, -m_viewHeightM + 0.9f, -0.7f}}, {1.0f, 0.2f, 1.0f}, {0.6f, 0.6f, 0.4f});
+
+            // Draw some blocks at the controller positions:
+            for (int j = 0; j < 2; j++) {
+                if (m_handPoseState[j].isActive) {
+                    framePacket.controllerInstances[j] = static_cast<int32_t>(m_cuboidInstances.size());
+                    RenderCuboid(m_handPose[j], m_controllerCuboidScale, {1.f, 1.f, 1.f});
+                }
+            }
+            for (int j = 0; j < m_blocks.size(); j++) {
+                auto &thisBlock = m_blocks[j];
+                XrVector3f sc = thisBlock.scale;
+                if (j == m_nearBlock[0] || j == m_nearBlock[1])
+                    sc = thisBlock.scale * 1.05f;
+                RenderCuboid(thisBlock.pose, sc, thisBlock.color);
+            }
+
+            // XR_DOCS_TAG_BEGIN_RenderHands
+            if (handTrackingSystemProperties.supportsHandTracking) {
+                for (int j = 0; j < 2; j++) {
+                    auto hand = m_hands[j];
+                    XrVector3f hand_color = {1.f, 1.f, 0.f};
+                    for (int k = 0; k < XR_HAND_JOINT_COUNT_EXT; k++) {
+                        XrVector3f sc = {1.5f, 1.5f, 2.5f};
+                        sc = sc * hand.m_jointLocations[k].radius;
+                        RenderCuboid(hand.m_jointLocations[k].pose, sc, hand_color);
+                    }
+                }
+            }
+            // XR_DOCS_TAG_END_RenderHands
+        }
+        // The render stage only reads the packet, so the simulation can move on to the next frame.
+        framePacket.cuboidInstances.swap(m_cuboidInstances);
+    }
+
+    // Render and submit stage: begins the frame, renders the packet's scene if the runtime wants it, and ends the frame.
+    // Runs on the thread that owns the graphics API. The simulation stage is run first when simulate is set.
+    void SubmitFrame(FramePacket &framePacket, bool simulate) {
+        const XrFrameState &frameState = framePacket.frameState;
 
         // Tell the OpenXR compositor that the application is beginning the frame.
         XrFrameBeginInfo frameBeginInfo{XR_TYPE_FRAME_BEGIN_INFO};
@@ -1162,19 +1676,17 @@ private:
         // Check that the session is active and that we should render.
         bool sessionActive = (m_sessionState == XR_SESSION_STATE_SYNCHRONIZED || m_sessionState == XR_SESSION_STATE_VISIBLE || m_sessionState == XR_SESSION_STATE_FOCUSED);
         if (sessionActive && frameState.shouldRender) {
-#if XR_DOCS_CHAPTER_VERSION >= XR_DOCS_CHAPTER_4_2
-            // XR_DOCS_TAG_BEGIN_CallPollActions
-            // poll actions here because they require a predicted display time, which we've only just obtained.
-            PollActions(frameState.predictedDisplayTime);
-            // Handle the interaction between the user and the 3D blocks.
-            BlockInteraction();
-            // XR_DOCS_TAG_END_CallPollActions
-#endif
+            if (simulate) {
+                SimulateFrame(framePacket);
+            }
             // Render the stereo image and associate one of swapchain images with the XrCompositionLayerProjection structure.
-            rendered = RenderLayer(renderLayerInfo);
+            rendered = RenderLayer(renderLayerInfo, framePacket);
             if (rendered) {
                 renderLayerInfo.layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader *>(&renderLayerInfo.layerProjection));
             }
+            if (m_gpuTimingsEnabled) {
+                CollectGpuTimings();
+            }
         }
 
         // Tell OpenXR that we are finished with this frame; specifying its display time, environment blending and layers.
@@ -1184,11 +1696,88 @@ private:
         frameEndInfo.layerCount = static_cast<uint32_t>(renderLayerInfo.layers.size());
         frameEndInfo.layers = renderLayerInfo.layers.data();
         OPENXR_CHECK(xrEndFrame(m_session, &frameEndInfo), "Failed to end the XR Frame.");
-        // XR_DOCS_TAG_END_RenderFrame
-#endif
+        m_graphicsAPI->EndFrame();
+    }
+
+    // With XR_TUTORIAL_FRAME_PIPELINE=1, each frame passes through three stages on three threads:
+    // a frame timing thread that only calls xrWaitFrame(), a simulation thread that runs SimulateFrame(), and this
+    // thread, which begins, renders and ends the frame. xrWaitFrame() for the next frame returns once this frame has
+    // begun, so the next frame is simulated while this one is recorded and submitted.
+    void RenderPipelinedFrame() {
+        if (!m_framePipelineRunning) {
+            StartFramePipeline();
+        }
+        FramePacket framePacket;
+        if (m_framePacketQueue.Pop(framePacket, m_simulationDone)) {
+            SubmitFrame(framePacket, false);
+            return;
+        }
+        // Both threads have finished without being stopped, so xrWaitFrame() failed on the frame timing thread. Report
+        // the error and carry on without the pipeline, as RenderFrame() would have done had it called xrWaitFrame() itself.
+        m_frameTimingThread.join();
+        m_simulationThread.join();
+        m_framePipelineRunning = false;
+        m_framePipelineEnabled = false;
+        OPENXR_CHECK(m_frameTimingResult.load(std::memory_order_acquire), "Failed to wait for XR Frame on the frame timing thread. The frame pipeline is disabled.");
     }
 
-    bool RenderLayer(RenderLayerInfo &renderLayerInfo) {
+    void StartFramePipeline() {
+        m_framePipelineStop = false;
+        m_frameTimingDone = false;
+        m_simulationDone = false;
+        m_frameTimingResult = XR_SUCCESS;
+        m_frameTimingThread = std::thread([this]() {
+            while (!m_framePipelineStop.load(std::memory_order_acquire)) {
+                XrFrameState frameState{XR_TYPE_FRAME_STATE};
+                XrFrameWaitInfo frameWaitInfo{XR_TYPE_FRAME_WAIT_INFO};
+                XrResult result = xrWaitFrame(m_session, &frameWaitInfo, &frameState);
+                if (XR_FAILED(result)) {
+                    m_frameTimingResult.store(result, std::memory_order_release);  // Reported by RenderPipelinedFrame().
+                    break;
+                }
+                // Every waited frame is passed on, so that it's also begun and ended.
+                m_frameTimingQueue.Push(std::move(frameState));
+            }
+            m_frameTimingDone.store(true, std::memory_order_release);
+        });
+        m_simulationThread = std::thread([this]() {
+            FramePacket framePacket;
+            while (m_frameTimingQueue.Pop(framePacket.frameState, m_frameTimingDone)) {
+                if (m_framePipelineStop.load(std::memory_order_acquire)) {
+                    framePacket.frameState.shouldRender = XR_FALSE;
+                }
+                SimulateFrame(framePacket);
+                m_framePacketQueue.Push(std::move(framePacket));
+                framePacket = {};
+            }
+            m_simulationDone.store(true, std::memory_order_release);
+        });
+        m_framePipelineRunning = true;
+    }
+
+    void StopFramePipeline() {
+        if (!m_framePipelineRunning) {
+            return;
+        }
+        m_framePipelineStop.store(true, std::memory_order_release);
+        // The frame timing thread may be blocked in xrWaitFrame() until the previous frame begins. Begin and end every
+        // frame still in the pipeline, without layers, until both threads have finished.
+        FramePacket framePacket;
+        while (m_framePacketQueue.Pop(framePacket, m_simulationDone)) {
+            XrFrameBeginInfo frameBeginInfo{XR_TYPE_FRAME_BEGIN_INFO};
+            xrBeginFrame(m_session, &frameBeginInfo);
+            XrFrameEndInfo frameEndInfo{XR_TYPE_FRAME_END_INFO};
+            frameEndInfo.displayTime = framePacket.frameState.predictedDisplayTime;
+            frameEndInfo.environmentBlendMode = m_environmentBlendMode;
+            xrEndFrame(m_session, &frameEndInfo);
+            m_graphicsAPI->EndFrame();
+        }
+        m_frameTimingThread.join();
+        m_simulationThread.join();
+        m_framePipelineRunning = false;
+    }
+
+    bool RenderLayer(RenderLayerInfo &renderLayerInfo, const FramePacket &framePacket) {
         // XR_DOCS_TAG_BEGIN_RenderLayer1
         // Locate the views from the view configuration within the (reference) space at the display time.
         std::vector<XrView> views(m_viewConfigurationViews.size(), {XR_TYPE_VIEW});
@@ -1213,6 +1802,14 @@ private:
         // XR_DOCS_TAG_END_ResizeLeyerDepthInfos
 #endif
 
+        // Cull once per frame against all of the views, before any of them are drawn.
+        float nearZ = 0.05f;
+        float farZ = 100.0f;
+        CullCuboids(framePacket, views, viewCount, nearZ, farZ);
+
+        CuboidFrameInfo cuboidFrame;
+        LateLatchedControllers lateLatchedControllers;
+
         // Per view in the view configuration:
         for (uint32_t i = 0; i < viewCount; i++) {
             SwapchainInfo &colorSwapchainInfo = m_colorSwapchainInfos[i];
@@ -1237,8 +1834,6 @@ private:
             const uint32_t &height = m_viewConfigurationViews[i].recommendedImageRectHeight;
             GraphicsAPI::Viewport viewport = {0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f};
             GraphicsAPI::Rect2D scissor = {{(int32_t)0, (int32_t)0}, {width, height}};
-            float nearZ = 0.05f;
-            float farZ = 100.0f;
 
             // Fill out the XrCompositionLayerProjectionView structure specifying the pose and fov from the view.
             // This also associates the swapchain image with this layer projection view.
@@ -1270,6 +1865,10 @@ private:
 
             // Rendering code to clear the color and depth image views.
             m_graphicsAPI->BeginRendering();
+            if (m_gpuTimingsEnabled) {
+                m_graphicsAPI->BeginTimestampScope(("View " + std::to_string(i)).c_str());
+                m_graphicsAPI->BeginTimestampScope("Clear");
+            }
 
             if (m_environmentBlendMode == XR_ENVIRONMENT_BLEND_MODE_OPAQUE) {
                 // VR mode use a background color.
@@ -1279,6 +1878,9 @@ private:
                 m_graphicsAPI->ClearColor(colorSwapchainInfo.imageViews[colorImageIndex], 0.00f, 0.00f, 0.00f, 1.00f);
             }
             m_graphicsAPI->ClearDepth(depthSwapchainInfo.imageViews[depthImageIndex], 1.0f);
+            if (m_gpuTimingsEnabled) {
+                m_graphicsAPI->EndTimestampScope();
+            }
             // XR_DOCS_TAG_END_RenderLayer1
 
             // XR_DOCS_TAG_BEGIN_SetupFrameRendering
@@ -1287,54 +1889,24 @@ private:
             m_graphicsAPI->SetScissors(&scissor, 1);
 
             // Compute the view-projection transform.
-            // All matrices (including OpenXR's) are column-major, right-handed.
-            XrMatrix4x4f proj;
-            XrMatrix4x4f_CreateProjectionFov(&proj, m_apiType, views[i].fov, nearZ, farZ);
-            XrMatrix4x4f toView;
-            XrVector3f scale1m{1.0f, 1.0f, 1.0f};
-            XrMatrix4x4f_CreateTranslationRotationScale(&toView, &views[i].pose.position, &views[i].pose.orientation, &scale1m);
-            XrMatrix4x4f view;
-            XrMatrix4x4f_InvertRigidBody(&view, &toView);
-            XrMatrix4x4f_Multiply(&cameraConstants.viewProj, &proj, &view);
+            cameraConstants.viewProj = CreateViewProjection(views[i], nearZ, farZ);
             // XR_DOCS_TAG_END_SetupFrameRendering
 
-            // XR_DOCS_TAG_BEGIN_CallRenderCuboid
-            renderCuboidIndex = 0;
-            // Draw a floor. Scale it by 2 in the X and Z, and 0.1 in the Y,
-            RenderCuboid({{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, -m_viewHeightM, 0.0f}}, {2.0f, 0.1f, 2.0f}, {0.4f, 0.5f, 0.5f});
-            // Draw a "table".
-            RenderCuboid({{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, -m_viewHeightM + 0.9f, -0.7f}}, {1.0f, 0.2f, 1.0f}, {0.6f, 0.6f, 0.4f});
-            // XR_DOCS_TAG_END_CallRenderCuboid
-
-            // XR_DOCS_TAG_BEGIN_CallRenderCuboid2
-            // Draw some blocks at the controller positions:
-            for (int j = 0; j < 2; j++) {
-                if (m_handPoseState[j].isActive) {
-                    RenderCuboid(m_handPose[j], {0.02f, 0.04f, 0.10f}, {1.f, 1.f, 1.f});
-                }
+            if (m_gpuTimingsEnabled) {
+                m_graphicsAPI->BeginTimestampScope("Cuboids");
             }
-            for (int j = 0; j < m_blocks.size(); j++) {
-                auto &thisBlock = m_blocks[j];
-                XrVector3f sc = thisBlock.scale;
-                if (j == m_nearBlock[0] || j == m_nearBlock[1])
-                    sc = thisBlock.scale * 1.05f;
-                RenderCuboid(thisBlock.pose, sc, thisBlock.color);
+            if (i == 0) {
+                cuboidFrame = UploadCuboids(m_visibleCuboids.instances);
+            }
+            CuboidDrawInfo cuboidDraw = DrawCuboids(cuboidFrame);
+            if (m_gpuTimingsEnabled) {
+                m_graphicsAPI->EndTimestampScope();
+                m_graphicsAPI->EndTimestampScope();
             }
-            // XR_DOCS_TAG_END_CallRenderCuboid2
 
-            // XR_DOCS_TAG_BEGIN_RenderHands
-            if (handTrackingSystemProperties.supportsHandTracking) {
-                for (int j = 0; j < 2; j++) {
-                    auto hand = m_hands[j];
-                    XrVector3f hand_color = {1.f, 1.f, 0.f};
-                    for (int k = 0; k < XR_HAND_JOINT_COUNT_EXT; k++) {
-                        XrVector3f sc = {1.5f, 1.5f, 2.5f};
-                        sc = sc * hand.m_jointLocations[k].radius;
-                        RenderCuboid(hand.m_jointLocations[k].pose, sc, hand_color);
-                    }
-                }
+            if (m_lateLatchEnabled) {
+                LateLatchView(i, renderLayerInfo, m_visibleCuboids, cuboidDraw, lateLatchedControllers, nearZ, farZ);
             }
-            // XR_DOCS_TAG_END_RenderHands
 
             // XR_DOCS_TAG_BEGIN_RenderLayer2
             m_graphicsAPI->EndRendering();
@@ -1457,6 +2029,29 @@ private:
     bool m_applicationRunning = true;
     bool m_sessionRunning = false;
 
+    // Idle wait while the session isn't running, see WaitWhileIdle().
+    bool m_idling = false;
+    XrSessionState m_idleSessionState = XR_SESSION_STATE_UNKNOWN;
+    std::chrono::milliseconds m_idleSleep{1};
+    std::chrono::steady_clock::time_point m_idlePeriodStart;
+    double m_idlePeriodCpuSeconds = 0.0;
+
+    // GPU time per timestamp scope path, as the sum of milliseconds and the number of samples. See CollectGpuTimings().
+    // Nothing is measured unless XR_TUTORIAL_GPU_TIMINGS=1.
+    bool m_gpuTimingsEnabled = false;
+    std::map<std::string, std::pair<double, uint32_t>> m_gpuTimings;
+    std::chrono::steady_clock::time_point m_gpuTimingPeriodStart;
+
+    // Cuboids drawn and culled since the period started, reported every 10 seconds with XR_TUTORIAL_CULLING_STATS=1.
+    struct CullingStats {
+        uint64_t drawn = 0;
+        uint64_t culled = 0;
+        uint64_t frames = 0;
+        std::chrono::steady_clock::time_point periodStart;
+    };
+    CullingStats m_cullingStats;
+    VisibleCuboids m_visibleCuboids;
+
     std::vector<XrViewConfigurationType> m_applicationViewConfigurations = {XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_MONO};
     std::vector<XrViewConfigurationType> m_viewConfigurations;
     XrViewConfigurationType m_viewConfiguration = XR_VIEW_CONFIGURATION_TYPE_MAX_ENUM;
@@ -1487,12 +2082,42 @@ private:
 #endif
     };
 
+    // Everything the render stage needs from the simulation stage for one frame.
+    struct FramePacket {
+        XrFrameState frameState{XR_TYPE_FRAME_STATE};
+        std::vector<CuboidInstance> cuboidInstances;
+        // The instances drawn at the controllers, or -1, so that late latching can move them.
+        int32_t controllerInstances[2] = {-1, -1};
+    };
+
+    // The optional frame pipeline, see RenderPipelinedFrame(). Each queue has one producer and one consumer thread.
+    bool m_framePipelineEnabled = false;
+    bool m_framePipelineRunning = false;
+    std::thread m_frameTimingThread;
+    std::thread m_simulationThread;
+    std::atomic<bool> m_framePipelineStop{false};
+    std::atomic<bool> m_frameTimingDone{false};
+    std::atomic<bool> m_simulationDone{false};
+    std::atomic<XrResult> m_frameTimingResult{XR_SUCCESS};  // The error that stopped the frame timing thread, if any.
+    SPSCQueue<XrFrameState, 2> m_frameTimingQueue;
+    SPSCQueue<FramePacket, 2> m_framePacketQueue;
+
+    // Set by XR_TUTORIAL_LATE_LATCH=1, see LateLatchView().
+    bool m_lateLatchEnabled = false;
+    XrVector3f m_controllerCuboidScale = {0.02f, 0.04f, 0.10f};
+
     // In STAGE space, viewHeightM should be 0. In LOCAL space, it should be offset downwards, below the viewer's initial position.
     float m_viewHeightM = 1.5f;
 
     // Vertex and index buffers: geometry for our cuboids.
     void *m_vertexBuffer = nullptr;
     void *m_indexBuffer = nullptr;
+    // Per-instance model matrices and colors for all cuboids in a view.
+    void *m_instanceBuffer = nullptr;
+    size_t m_maxCuboidCount = 0;
+    size_t m_framesInFlight = 1;
+    size_t m_cuboidDrawIndex = 0;
+    size_t m_cuboidFrameIndex = 0;
     // Camera values constant buffer for the shaders.
     void *m_uniformBuffer_Camera = nullptr;
     // The normals are stored in a uniform buffer to simplify our vertex geometry.
@@ -1520,6 +2145,9 @@ private:
     // Which block, if any, is nearby to each hand or controller.
     int m_nearBlock[2] = {-1, -1};
     // XR_DOCS_TAG_END_Objects
+    // Block indices per 10cm cell, and the cell each block is filed under. See GetBlockGridKey().
+    std::unordered_map<int64_t, std::vector<int>> m_blockGrid;
+    std::vector<int64_t> m_blockGridKeys;
 
     // XR_DOCS_TAG_BEGIN_Actions
     XrActionSet m_actionSet;
@@ -1623,6 +2251,10 @@ void android_main(struct android_app *app) {
 
     OpenXRTutorial::androidApp = app;
     // XR_DOCS_TAG_END_android_main___ANDROID__
+    // Lets GraphicsAPI_OpenGL_ES keep its program binary cache in the app's private storage.
+    if (app->activity->internalDataPath) {
+        SetEnv("XR_TUTORIAL_OPENGL_PROGRAM_CACHE_DIR", app->activity->internalDataPath);
+    }
     OpenXRTutorial_Main(XR_TUTORIAL_GRAPHICS_API);
 }
 /*
@@ -266,10 +266,15 @@ public:
         const char* semanticName;
     };
     typedef std::vector<VertexInputAttribute> VertexInputAttributes;
+    enum class VertexInputRate : uint8_t {
+        PER_VERTEX = 0,
+        PER_INSTANCE = 1
+    };
     struct VertexInputBinding {
         uint32_t bindingIndex;  // Which buffer to use when bound for draws.
         size_t offset;
         size_t stride;
+        VertexInputRate inputRate;  // Zero-initialised to PER_VERTEX when omitted.
     };
     typedef std::vector<VertexInputBinding> VertexInputBindings;
     struct VertexInputState {
@@ -337,6 +342,10 @@ public:
         bool readWrite;
         size_t bufferOffset;
         size_t bufferSize;
+        // BUFFER only: bufferOffset is applied when the descriptor is bound rather than when it is written, so draws that
+        // differ only by offset can share one descriptor. Set it in both PipelineCreateInfo::layout and SetDescriptor().
+        // The offset must be a multiple of the device's minimum uniform/storage buffer offset alignment.
+        bool dynamicOffset;
     };
     struct PipelineCreateInfo {
         std::vector<void*> shaders;
@@ -365,10 +374,28 @@ public:
             VERTEX,
             INDEX,
             UNIFORM,
+            INDIRECT,  // Holds DrawIndexedIndirectCommand records read by DrawIndexedIndirect().
         } type;
         size_t stride;
         size_t size;
         void* data;
+        // How often the contents are expected to change. STATIC buffers may be placed in memory the CPU cannot access
+        // directly, making SetBufferData() on them a comparatively expensive staged copy.
+        enum class Usage : uint8_t {
+            DYNAMIC = 0,  // Zero-initialised to DYNAMIC when omitted.
+            STATIC = 1,
+            STREAM = 2,   // Rewritten every frame.
+        } usage;
+    };
+
+    // Layout of one draw in an INDIRECT buffer. Matches VkDrawIndexedIndirectCommand, GL's DrawElementsIndirectCommand
+    // and D3D's D3D1X_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS, so the same buffer contents work on every backend.
+    struct DrawIndexedIndirectCommand {
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t firstInstance;
     };
 
     struct ImageCreateInfo {
@@ -501,11 +528,55 @@ public:
     virtual void* CreatePipeline(const PipelineCreateInfo& pipelineCI) = 0;
     virtual void DestroyPipeline(void*& pipeline) = 0;
 
+    // Starts creating a pipeline without waiting for the driver to finish compiling it. The handle may be destroyed at
+    // any time, but should only be rendered with once IsPipelineReady() returns true; SetPipeline() waits for it otherwise.
+    // APIs without asynchronous compilation create the pipeline immediately.
+    virtual void* CreatePipelineAsync(const PipelineCreateInfo& pipelineCI) { return CreatePipeline(pipelineCI); }
+    virtual bool IsPipelineReady(void* pipeline) { return true; }
+
     virtual void BeginRendering() = 0;
     virtual void EndRendering() = 0;
+    // Optional. Call once per frame, after xrEndFrame(), to end the frame's statistics and per-frame state.
+    virtual void EndFrame() {}
+
+    // The number of BeginRendering()/EndRendering() submissions the GPU may still be executing when a new one begins.
+    // Buffer regions written for one submission should not be rewritten until this many further submissions have begun.
+    virtual uint32_t GetFramesInFlight() { return 1; }
+    // True if nothing recorded after BeginRendering() reaches the GPU before EndRendering() submits it. Buffer data that
+    // those commands read may then still be rewritten, through SetBufferData() or a TransientBufferAllocation, until
+    // EndRendering() is called. This allows late latching of poses.
+    virtual bool DefersCommandExecution() { return false; }
+
+    struct TransientBufferAllocation {
+        void* buffer;   // The buffer to bind, e.g. as a DescriptorInfo::resource.
+        size_t offset;  // The offset of the allocation within the buffer.
+        void* data;     // The CPU write pointer to the allocation.
+    };
+    // Sub-allocates uniform data that only needs to live until the current submission has completed on the GPU.
+    // Returns data == nullptr if the API doesn't provide transient allocations or has run out of space for this submission.
+    virtual TransientBufferAllocation AllocateTransientUniformData(size_t size) { return {nullptr, 0, nullptr}; }
 
     virtual void SetBufferData(void* buffer, size_t offset, size_t size, void* data) = 0;
 
+    // GPU timing. Scopes may nest and must be opened and closed between BeginRendering() and EndRendering(). Their
+    // queries are read back a few submissions later, so measuring never waits for the GPU. APIs without timestamp
+    // queries ignore the scopes.
+    virtual void BeginTimestampScope(const char* name) {}
+    virtual void EndTimestampScope() {}
+
+    struct TimestampScopeResult {
+        std::string name;
+        uint32_t depth;       // The number of enclosing scopes.
+        uint64_t submission;  // The BeginRendering()/EndRendering() pair that the scope was recorded in.
+        double milliseconds;
+    };
+    // Returns the results that have become available since the last call, in the order the scopes were opened.
+    std::vector<TimestampScopeResult> GetTimestampScopeResults() {
+        std::vector<TimestampScopeResult> results;
+        results.swap(timestampScopeResults);
+        return results;
+    }
+
     virtual void ClearColor(void* imageView, float r, float g, float b, float a) = 0;
     virtual void ClearDepth(void* imageView, float d) = 0;
 
@@ -520,9 +591,22 @@ public:
     virtual void SetIndexBuffer(void* indexBuffer) = 0;
     virtual void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0) = 0;
     virtual void Draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0) = 0;
+    // Issues drawCount indexed draws whose parameters are read from an INDIRECT buffer, starting at offset bytes.
+    // A stride of 0 means the commands are tightly packed.
+    virtual void DrawIndexedIndirect(void* indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride = 0) = 0;
 
 protected:
     virtual const std::vector<int64_t> GetSupportedColorSwapchainFormats() = 0;
     virtual const std::vector<int64_t> GetSupportedDepthSwapchainFormats() = 0;
     bool debugAPI = false;
+
+    // A scope recorded into a submission, whose begin and end timestamps are written to the queries at these indices.
+    struct TimestampScope {
+        std::string name;
+        uint32_t depth;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+    static constexpr uint32_t maxTimestampScopes = 32;  // Per submission.
+    std::vector<TimestampScopeResult> timestampScopeResults;
 };
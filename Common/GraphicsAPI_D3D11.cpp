@@ -33,6 +33,9 @@ static D3D11_BIND_FLAG ToD3D11BindFlag(GraphicsAPI::BufferCreateInfo::Type type)
     case GraphicsAPI::BufferCreateInfo::Type::INDEX: {
         return D3D11_BIND_INDEX_BUFFER;
     }
+    case GraphicsAPI::BufferCreateInfo::Type::INDIRECT: {
+        return (D3D11_BIND_FLAG)0;  // Identified by D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS instead.
+    }
     case GraphicsAPI::BufferCreateInfo::Type::UNIFORM:
     default: {
         return D3D11_BIND_CONSTANT_BUFFER;
@@ -565,22 +568,24 @@ void *GraphicsAPI_D3D11::CreateBuffer(const BufferCreateInfo &bufferCI) {
     initData.pSysMem = bufferCI.data;
     initData.SysMemPitch = (UINT)bufferCI.stride;
     initData.SysMemSlicePitch = 0;
-    bool cpu_access = true;
-    //(bufferCI.type == GraphicsAPI::BufferCreateInfo::Type::UNIFORM);
+    // Indirect argument buffers can't be D3D11_USAGE_DYNAMIC, so they are always updated like STATIC buffers.
+    bool cpu_access = bufferCI.usage != BufferCreateInfo::Usage::STATIC && bufferCI.type != BufferCreateInfo::Type::INDIRECT;
 
     D3D11_BUFFER_DESC desc{};
     desc.ByteWidth = (UINT)(bufferCI.size);
     desc.Usage = cpu_access ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
     desc.BindFlags = ToD3D11BindFlag(bufferCI.type);
     desc.CPUAccessFlags = (cpu_access ? D3D11_CPU_ACCESS_WRITE : (UINT)0);
-    desc.MiscFlags = (UINT)0;
+    desc.MiscFlags = bufferCI.type == BufferCreateInfo::Type::INDIRECT ? D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS : (UINT)0;
     desc.StructureByteStride = 0;
 
     ID3D11Buffer *d3D11Buffer = nullptr;
     D3D11_CHECK(device->CreateBuffer(&desc, bufferCI.data ? &initData : nullptr, &d3D11Buffer), "Failed to create Buffer");
 
-    SetBufferData(d3D11Buffer, 0, bufferCI.size, bufferCI.data);
     buffers[d3D11Buffer] = bufferCI;
+    if (cpu_access) {
+        SetBufferData(d3D11Buffer, 0, bufferCI.size, bufferCI.data);
+    }
 
     return d3D11Buffer;
 }
@@ -664,6 +669,25 @@ void GraphicsAPI_D3D11::EndRendering() {
 
 void GraphicsAPI_D3D11::SetBufferData(void *buffer, size_t offset, size_t size, void *data) {
     ID3D11Buffer *d3d11Buffer = (ID3D11Buffer *)buffer;
+    const BufferCreateInfo &bufferCI = buffers[d3d11Buffer];
+    if (bufferCI.usage == BufferCreateInfo::Usage::STATIC || bufferCI.type == BufferCreateInfo::Type::INDIRECT) {
+        // D3D11_USAGE_DEFAULT buffers can't be mapped. Constant buffers can only be updated as a whole, with a nullptr box.
+        if (!data) {
+            return;
+        }
+        if (bufferCI.type == BufferCreateInfo::Type::UNIFORM) {
+            if (offset != 0 || size != bufferCI.size) {
+                std::cout << "ERROR: D3D11: Static Uniform Buffers can only be updated as a whole." << std::endl;
+                return;
+            }
+            immediateContext->UpdateSubresource(d3d11Buffer, 0, nullptr, data, 0, 0);
+        } else {
+            D3D11_BOX box = {(UINT)offset, 0, 0, (UINT)(offset + size), 1, 1};
+            immediateContext->UpdateSubresource(d3d11Buffer, 0, &box, data, 0, 0);
+        }
+        return;
+    }
+
     D3D11_MAPPED_SUBRESOURCE mappedSubresource = {};
     D3D11_CHECK(immediateContext->Map(d3d11Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresource), "Failed to map Resource.");
     if (mappedSubresource.pData && data)
@@ -759,14 +783,21 @@ void GraphicsAPI_D3D11::SetPipeline(void *pipeline) {
 
         std::vector<D3D11_INPUT_ELEMENT_DESC> elements;
         for (const VertexInputAttribute &attribute : pipelineCI.vertexInputState.attributes) {
+            bool perInstance = false;
+            for (const VertexInputBinding &binding : pipelineCI.vertexInputState.bindings) {
+                if (binding.bindingIndex == attribute.bindingIndex) {
+                    perInstance = binding.inputRate == VertexInputRate::PER_INSTANCE;
+                }
+            }
+
             D3D11_INPUT_ELEMENT_DESC element{};
             element.SemanticName = attribute.semanticName;
             element.SemanticIndex = attribute.attribIndex;
             element.Format = ToDXGI_FORMAT(attribute.vertexType);
             element.InputSlot = attribute.bindingIndex;
             element.AlignedByteOffset = (UINT)attribute.offset;
-            element.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-            element.InstanceDataStepRate = 0;
+            element.InputSlotClass = perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+            element.InstanceDataStepRate = perInstance ? 1 : 0;
             elements.push_back(element);
         }
 
@@ -991,6 +1022,16 @@ void GraphicsAPI_D3D11::DrawIndexed(uint32_t indexCount, uint32_t instanceCount,
     immediateContext->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 }
 
+void GraphicsAPI_D3D11::DrawIndexedIndirect(void *indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    // D3D11 has no multi-draw indirect, so each command is a separate call.
+    if (!stride) {
+        stride = sizeof(DrawIndexedIndirectCommand);
+    }
+    for (uint32_t i = 0; i < drawCount; i++) {
+        immediateContext->DrawIndexedInstancedIndirect((ID3D11Buffer *)indirectBuffer, (UINT)(offset + (size_t)i * stride));
+    }
+}
+
 void GraphicsAPI_D3D11::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
     immediateContext->DrawInstanced(vertexCount, instanceCount, firstVertex, firstInstance);
 }
@@ -292,6 +292,9 @@ GraphicsAPI_D3D12::GraphicsAPI_D3D12(XrInstance m_xrInstance, XrSystemId systemI
 }
 
 GraphicsAPI_D3D12 ::~GraphicsAPI_D3D12() {
+    for (auto &commandSignature : drawIndexedCommandSignatures) {
+        D3D12_SAFE_RELEASE(commandSignature.second);
+    }
     D3D12_SAFE_RELEASE(SAMPLER_DescriptorHeap);
     D3D12_SAFE_RELEASE(CBV_SRV_UAV_DescriptorHeap);
     D3D12_SAFE_RELEASE(queue);
@@ -736,6 +739,8 @@ void *GraphicsAPI_D3D12::CreateBuffer(const BufferCreateInfo &bufferCI) {
             initState = D3D12_RESOURCE_STATE_INDEX_BUFFER;
         } else if (bufferCI.type == BufferCreateInfo::Type::UNIFORM) {
             initState = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+        } else if (bufferCI.type == BufferCreateInfo::Type::INDIRECT) {
+            initState = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
         } else {
             std::cout << "ERROR: D3D12: Unknown Buffer Type." << std::endl;
         }
@@ -810,14 +815,21 @@ void *GraphicsAPI_D3D12::CreatePipeline(const PipelineCreateInfo &pipelineCI) {
     // VertexInput
     std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
     for (auto &attrib : pipelineCI.vertexInputState.attributes) {
+        bool perInstance = false;
+        for (auto &binding : pipelineCI.vertexInputState.bindings) {
+            if (binding.bindingIndex == attrib.bindingIndex) {
+                perInstance = binding.inputRate == VertexInputRate::PER_INSTANCE;
+            }
+        }
+
         D3D12_INPUT_ELEMENT_DESC il;
         il.SemanticName = attrib.semanticName;
         il.SemanticIndex = attrib.attribIndex;
         il.Format = ToDXGI_FORMAT(attrib.vertexType);
         il.InputSlot = attrib.bindingIndex;
         il.AlignedByteOffset = attrib.offset;
-        il.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
-        il.InstanceDataStepRate = 0;
+        il.InputSlotClass = perInstance ? D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA : D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+        il.InstanceDataStepRate = perInstance ? 1 : 0;
         inputLayout.push_back(il);
     }
     GPSD.InputLayout = {inputLayout.data(), (UINT)inputLayout.size()};
@@ -1266,6 +1278,25 @@ void GraphicsAPI_D3D12::DrawIndexed(uint32_t indexCount, uint32_t instanceCount,
     cmdList->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 }
 
+void GraphicsAPI_D3D12::DrawIndexedIndirect(void *indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    if (!stride) {
+        stride = sizeof(DrawIndexedIndirectCommand);
+    }
+    ID3D12CommandSignature *&commandSignature = drawIndexedCommandSignatures[stride];
+    if (!commandSignature) {
+        D3D12_INDIRECT_ARGUMENT_DESC argumentDesc = {};
+        argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+        commandSignatureDesc.ByteStride = stride;
+        commandSignatureDesc.NumArgumentDescs = 1;
+        commandSignatureDesc.pArgumentDescs = &argumentDesc;
+        commandSignatureDesc.NodeMask = 0;
+        D3D12_CHECK(device->CreateCommandSignature(&commandSignatureDesc, nullptr, IID_PPV_ARGS(&commandSignature)), "Failed to create CommandSignature.");
+    }
+    cmdList->ExecuteIndirect(commandSignature, drawCount, (ID3D12Resource *)indirectBuffer, offset, nullptr, 0);
+}
+
 void GraphicsAPI_D3D12::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
     cmdList->DrawInstanced(vertexCount, instanceCount, firstVertex, firstInstance);
 }
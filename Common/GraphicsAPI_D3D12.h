@@ -60,6 +60,7 @@ public:
 
     virtual void BeginRendering() override;
     virtual void EndRendering() override;
+    virtual bool DefersCommandExecution() override { return true; }
 
     virtual void ClearColor(void* imageView, float r, float g, float b, float a) override;
     virtual void ClearDepth(void* imageView, float d) override;
@@ -77,6 +78,7 @@ public:
     virtual void SetIndexBuffer(void* indexBuffer) override;
     virtual void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0) override;
     virtual void Draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0) override;
+    virtual void DrawIndexedIndirect(void* indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride = 0) override;
 
 private:
     virtual const std::vector<int64_t> GetSupportedColorSwapchainFormats() override;
@@ -117,5 +119,8 @@ private:
 
     std::unordered_map<ID3D12PipelineState*, std::pair<ID3D12RootSignature*, PipelineCreateInfo>> pipelineResources;
     ID3D12PipelineState* setPipeline = nullptr;
+
+    // ExecuteIndirect() needs a command signature for each argument stride. Created on first use.
+    std::unordered_map<uint32_t, ID3D12CommandSignature*> drawIndexedCommandSignatures;
 };
 #endif
@@ -13,7 +13,9 @@ PROC GetExtension(const char *functionName) { return wglGetProcAddress(functionN
 #elif defined(OS_APPLE)
 void (*GetExtension(const char *functionName))() { return NULL; }
 #elif defined(OS_LINUX_XCB) || defined(OS_LINUX_XLIB) || defined(OS_LINUX_XCB_GLX)
-void (*GetExtension(const char *functionName))() { return glXGetProcAddress((const GLubyte *)functionName); }
+// Set by headless contexts, which are created with EGL rather than GLX.
+static bool useEGLGetProcAddress = false;
+void (*GetExtension(const char *functionName))() { return useEGLGetProcAddress ? eglGetProcAddress(functionName) : glXGetProcAddress((const GLubyte *)functionName); }
 #elif defined(OS_ANDROID) || defined(OS_LINUX_WAYLAND)
 void (*GetExtension(const char *functionName))() { return eglGetProcAddress(functionName); }
 #endif
@@ -355,22 +357,36 @@ void GLDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLs
         DEBUG_BREAK;
 }
 
-GraphicsAPI_OpenGL::GraphicsAPI_OpenGL() {
-    // https://github.com/KhronosGroup/OpenXR-SDK-Source/blob/f122f9f1fc729e2dc82e12c3ce73efa875182854/src/tests/hello_xr/graphicsplugin_opengl.cpp#L103-L121
-    // Initialize the gl extensions. Note we have to open a window.
-    ksDriverInstance driverInstance{};
-    ksGpuQueueInfo queueInfo{};
-    ksGpuSurfaceColorFormat colorFormat{KS_GPU_SURFACE_COLOR_FORMAT_B8G8R8A8};
-    ksGpuSurfaceDepthFormat depthFormat{KS_GPU_SURFACE_DEPTH_FORMAT_D24};
-    ksGpuSampleCount sampleCount{KS_GPU_SAMPLE_COUNT_1};
-    if (!ksGpuWindow_Create(&window, &driverInstance, &queueInfo, 0, colorFormat, depthFormat, sampleCount, 640, 480, false)) {
-        std::cerr << "ERROR: OPENGL: Failed to create Context." << std::endl;
+GraphicsAPI_OpenGL::GraphicsAPI_OpenGL(bool headless)
+    : headless(headless) {
+    if (headless) {
+        if (!CreateHeadlessContext()) {
+            std::cerr << "ERROR: OPENGL: Failed to create headless Context." << std::endl;
+            contextCreated = false;
+            return;
+        }
+    } else {
+        // https://github.com/KhronosGroup/OpenXR-SDK-Source/blob/f122f9f1fc729e2dc82e12c3ce73efa875182854/src/tests/hello_xr/graphicsplugin_opengl.cpp#L103-L121
+        // Initialize the gl extensions. Note we have to open a window.
+        ksDriverInstance driverInstance{};
+        ksGpuQueueInfo queueInfo{};
+        ksGpuSurfaceColorFormat colorFormat{KS_GPU_SURFACE_COLOR_FORMAT_B8G8R8A8};
+        ksGpuSurfaceDepthFormat depthFormat{KS_GPU_SURFACE_DEPTH_FORMAT_D24};
+        ksGpuSampleCount sampleCount{KS_GPU_SAMPLE_COUNT_1};
+        if (!ksGpuWindow_Create(&window, &driverInstance, &queueInfo, 0, colorFormat, depthFormat, sampleCount, 640, 480, false)) {
+            std::cerr << "ERROR: OPENGL: Failed to create Context." << std::endl;
+            contextCreated = false;
+            return;
+        }
     }
 
     GLint glMajorVersion = 0;
     GLint glMinorVersion = 0;
     glGetIntegerv(GL_MAJOR_VERSION, &glMajorVersion);
     glGetIntegerv(GL_MINOR_VERSION, &glMinorVersion);
+    LoadExtensionFunctions(glMajorVersion, glMinorVersion);
+    CreateStreamingResources();
+    CreateProgramBinaryCache();
 
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -400,6 +416,9 @@ GraphicsAPI_OpenGL::GraphicsAPI_OpenGL(XrInstance m_xrInstance, XrSystemId syste
     GLint glMinorVersion = 0;
     glGetIntegerv(GL_MAJOR_VERSION, &glMajorVersion);
     glGetIntegerv(GL_MINOR_VERSION, &glMinorVersion);
+    LoadExtensionFunctions(glMajorVersion, glMinorVersion);
+    CreateStreamingResources();
+    CreateProgramBinaryCache();
 
     const XrVersion glApiVersion = XR_MAKE_VERSION(glMajorVersion, glMinorVersion, 0);
     if (graphicsRequirements.minApiVersionSupported > glApiVersion) {
@@ -416,15 +435,316 @@ GraphicsAPI_OpenGL::GraphicsAPI_OpenGL(XrInstance m_xrInstance, XrSystemId syste
 }
 
 GraphicsAPI_OpenGL::~GraphicsAPI_OpenGL() {
-    ksGpuWindow_Destroy(&window);
+    if (!contextCreated) {
+        if (headless) {
+            DestroyHeadlessContext();  // Releases whatever was created before the failure.
+        }
+        return;
+    }
+    for (TimestampFrame &timestampFrame : timestampFrames) {
+        glDeleteQueries(static_cast<GLsizei>(timestampFrame.queries.size()), timestampFrame.queries.data());
+    }
+    DestroyProgramBinaryCache();
+    DestroyStreamingResources();
+    for (const auto &framebuffer : framebufferCache) {
+        glDeleteFramebuffers(1, &framebuffer.second);
+    }
+    for (const auto &vertexArray : vertexArrayCache) {
+        glDeleteVertexArrays(1, &vertexArray.second);
+    }
+    if (headless) {
+        DestroyHeadlessContext();
+    } else {
+        ksGpuWindow_Destroy(&window);
+    }
 }
 // XR_DOCS_TAG_END_GraphicsAPI_OpenGL
 
+bool GraphicsAPI_OpenGL::CreateHeadlessContext() {
+#if defined(XR_TUTORIAL_OPENGL_HEADLESS_EGL)
+    if (gladLoaderLoadEGL(EGL_NO_DISPLAY) == 0) {
+        std::cout << "ERROR: OPENGL: Failed to load EGL." << std::endl;
+        return false;
+    }
+
+    // EGL_MESA_platform_surfaceless needs neither a display server nor a GPU, so it works with llvmpipe. Otherwise, use
+    // the default display and render through a pbuffer.
+    // glad only loads EGL 1.0 before a display is initialized, so eglGetPlatformDisplay() is resolved here.
+    PFNEGLGETPLATFORMDISPLAYPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYPROC)eglGetProcAddress("eglGetPlatformDisplay");
+    if (!getPlatformDisplay) {
+        getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    }
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (getPlatformDisplay && clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, nullptr, nullptr);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint eglMajorVersion = 0;
+    EGLint eglMinorVersion = 0;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &eglMajorVersion, &eglMinorVersion)) {
+        std::cout << "ERROR: OPENGL: Failed to initialize an EGL display." << std::endl;
+        return false;
+    }
+    // Reload now that the display's extensions can be queried.
+    gladLoaderLoadEGL(eglDisplay);
+
+    const char *displayExtensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    const bool surfacelessContext = displayExtensions && strstr(displayExtensions, "EGL_KHR_surfaceless_context");
+
+    // clang-format off
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfacelessContext ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE,
+    };
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, OPENGL_VERSION_MAJOR,
+        EGL_CONTEXT_MINOR_VERSION, OPENGL_VERSION_MINOR,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    const EGLint pbufferAttribs[] = {
+        EGL_WIDTH, 1,
+        EGL_HEIGHT, 1,
+        EGL_NONE,
+    };
+    // clang-format on
+
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(eglDisplay, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        std::cout << "ERROR: OPENGL: Failed to find an EGL config for OpenGL." << std::endl;
+        return false;
+    }
+    eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT) {
+        std::cout << "ERROR: OPENGL: Failed to create an OpenGL " << OPENGL_VERSION_MAJOR << "." << OPENGL_VERSION_MINOR << " core EGL context." << std::endl;
+        return false;
+    }
+    if (!surfacelessContext) {
+        eglSurface = eglCreatePbufferSurface(eglDisplay, config, pbufferAttribs);
+        if (eglSurface == EGL_NO_SURFACE) {
+            std::cout << "ERROR: OPENGL: Failed to create an EGL pbuffer surface." << std::endl;
+            return false;
+        }
+    }
+    if (!eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+        std::cout << "ERROR: OPENGL: Failed to make the EGL context current." << std::endl;
+        return false;
+    }
+
+#if defined(OS_LINUX_XCB) || defined(OS_LINUX_XLIB) || defined(OS_LINUX_XCB_GLX)
+    useEGLGetProcAddress = true;
+#endif
+    if (gladLoadGL((GLADloadfunc)eglGetProcAddress) == 0) {
+        std::cout << "ERROR: OPENGL: Failed to load OpenGL through EGL." << std::endl;
+        return false;
+    }
+    std::cout << "OPENGL: Created a headless context with EGL " << eglMajorVersion << "." << eglMinorVersion << (surfacelessContext ? " (surfaceless)" : " (pbuffer)") << " on " << glGetString(GL_RENDERER) << "." << std::endl;
+    return true;
+#else
+    std::cout << "ERROR: OPENGL: Headless contexts are only supported on Linux." << std::endl;
+    return false;
+#endif
+}
+
+void GraphicsAPI_OpenGL::DestroyHeadlessContext() {
+#if defined(XR_TUTORIAL_OPENGL_HEADLESS_EGL)
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        return;
+    }
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (eglSurface != EGL_NO_SURFACE) {
+        eglDestroySurface(eglDisplay, eglSurface);
+        eglSurface = EGL_NO_SURFACE;
+    }
+    if (eglContext != EGL_NO_CONTEXT) {
+        eglDestroyContext(eglDisplay, eglContext);
+        eglContext = EGL_NO_CONTEXT;
+    }
+    eglTerminate(eglDisplay);
+    eglDisplay = EGL_NO_DISPLAY;
+#endif
+}
+
+// Optional functions, such as those from EXT extensions, are checked for nullptr where they are used.
+#define GL_LOAD_EXTENSION_FUNCTION(name, required)                                \
+    {                                                                             \
+        ext.name = (decltype(ext.name))GetExtension(#name);                       \
+        if (!ext.name && required) {                                              \
+            std::cout << "ERROR: OPENGL: Failed to load " #name "." << std::endl; \
+        }                                                                         \
+    }
+
+void GraphicsAPI_OpenGL::LoadExtensionFunctions(GLint majorVersion, GLint minorVersion) {
+    GL_LOAD_EXTENSION_FUNCTION(glGenSamplers, true);
+    GL_LOAD_EXTENSION_FUNCTION(glSamplerParameteri, true);
+    GL_LOAD_EXTENSION_FUNCTION(glSamplerParameterf, true);
+    GL_LOAD_EXTENSION_FUNCTION(glSamplerParameterfv, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDeleteSamplers, true);
+    GL_LOAD_EXTENSION_FUNCTION(glValidateProgram, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDetachShader, true);
+    GL_LOAD_EXTENSION_FUNCTION(glViewportIndexedf, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDepthRangeIndexed, true);
+    GL_LOAD_EXTENSION_FUNCTION(glScissorIndexed, true);
+    GL_LOAD_EXTENSION_FUNCTION(glMinSampleShading, true);
+    GL_LOAD_EXTENSION_FUNCTION(glSampleMaski, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDepthBoundsEXT, false);
+    GL_LOAD_EXTENSION_FUNCTION(glStencilOpSeparate, true);
+    GL_LOAD_EXTENSION_FUNCTION(glStencilFuncSeparate, true);
+    GL_LOAD_EXTENSION_FUNCTION(glStencilMaskSeparate, true);
+    GL_LOAD_EXTENSION_FUNCTION(glEnablei, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDisablei, true);
+    GL_LOAD_EXTENSION_FUNCTION(glBlendEquationSeparatei, true);
+    GL_LOAD_EXTENSION_FUNCTION(glBlendFuncSeparatei, true);
+    GL_LOAD_EXTENSION_FUNCTION(glColorMaski, true);
+    GL_LOAD_EXTENSION_FUNCTION(glBindBufferRange, true);
+    GL_LOAD_EXTENSION_FUNCTION(glBindSampler, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDrawElementsInstancedBaseVertexBaseInstance, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDrawArraysInstancedBaseInstance, true);
+    GL_LOAD_EXTENSION_FUNCTION(glBufferStorage, false);
+    GL_LOAD_EXTENSION_FUNCTION(glMapBufferRange, true);
+    GL_LOAD_EXTENSION_FUNCTION(glFenceSync, true);
+    GL_LOAD_EXTENSION_FUNCTION(glClientWaitSync, true);
+    GL_LOAD_EXTENSION_FUNCTION(glDeleteSync, true);
+    GL_LOAD_EXTENSION_FUNCTION(glGetProgramBinary, false);
+    GL_LOAD_EXTENSION_FUNCTION(glProgramBinary, false);
+    GL_LOAD_EXTENSION_FUNCTION(glProgramParameteri, false);
+    GL_LOAD_EXTENSION_FUNCTION(glQueryCounter, false);
+    GL_LOAD_EXTENSION_FUNCTION(glGetQueryObjectui64v, false);
+    GL_LOAD_EXTENSION_FUNCTION(glDrawElementsIndirect, false);
+    GL_LOAD_EXTENSION_FUNCTION(glMultiDrawElementsIndirect, false);
+
+    // GetExtension() may return an address for any name, so optional entry points are also gated on the context's
+    // version and extensions.
+    const GLint version = majorVersion * 10 + minorVersion;
+    if (!IsExtensionSupported("GL_EXT_depth_bounds_test")) {
+        ext.glDepthBoundsEXT = nullptr;
+    }
+    if (version < 44 && !IsExtensionSupported("GL_ARB_buffer_storage")) {
+        ext.glBufferStorage = nullptr;
+    }
+    if (version < 41 && !IsExtensionSupported("GL_ARB_get_program_binary")) {
+        ext.glGetProgramBinary = nullptr;
+        ext.glProgramBinary = nullptr;
+        ext.glProgramParameteri = nullptr;
+    }
+    if (version < 33 && !IsExtensionSupported("GL_ARB_timer_query")) {
+        ext.glQueryCounter = nullptr;
+        ext.glGetQueryObjectui64v = nullptr;
+    }
+    if (version < 40 && !IsExtensionSupported("GL_ARB_draw_indirect")) {
+        ext.glDrawElementsIndirect = nullptr;
+    }
+    if (version < 43 && !IsExtensionSupported("GL_ARB_multi_draw_indirect")) {
+        ext.glMultiDrawElementsIndirect = nullptr;
+    }
+
+    // Lets glCompileShader() and glLinkProgram() return before the work is done. The ARB extension shares the KHR enums.
+    if (IsExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        GL_LOAD_EXTENSION_FUNCTION(glMaxShaderCompilerThreadsKHR, false);
+    } else if (IsExtensionSupported("GL_ARB_parallel_shader_compile")) {
+        ext.glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)GetExtension("glMaxShaderCompilerThreadsARB");
+    }
+    if (ext.glMaxShaderCompilerThreadsKHR) {
+        ext.glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);  // Let the driver choose the number of threads.
+    }
+
+    benchmark = GetEnv("XR_TUTORIAL_OPENGL_BENCHMARK") == "1";
+    if (benchmark) {
+        BenchmarkExtensionFunctions();
+    }
+}
+#undef GL_LOAD_EXTENSION_FUNCTION
+
+bool GraphicsAPI_OpenGL::IsExtensionSupported(const char *name) {
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GraphicsAPI_OpenGL::BenchmarkExtensionFunctions() {
+    // Compares the per-call cost of resolving an entry point by name, as DrawIndexed() used to do on every draw, with
+    // reading it from the dispatch table.
+    const int iterations = 100000;
+    volatile uint64_t sink = 0;
+    const ExtensionFunctions *volatile table = &ext;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        sink = sink + (uint64_t)GetExtension("glDrawElementsInstancedBaseVertexBaseInstance");
+    }
+    double lookupNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        sink = sink + (uint64_t)table->glDrawElementsInstancedBaseVertexBaseInstance;
+    }
+    double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    std::cout << "OPENGL: Resolving an entry point by name: " << lookupNs << " ns per call | dispatch table: " << tableNs << " ns per call." << std::endl;
+}
+
+void GraphicsAPI_OpenGL::CreateStreamingResources() {
+    // Without persistent mapping, buffer updates go through glBufferSubData(), which the driver synchronises itself.
+    uint32_t framesInFlight = ext.glBufferStorage ? 3 : 1;
+    std::string framesInFlightEnv = GetEnv("XR_TUTORIAL_OPENGL_FRAMES_IN_FLIGHT");
+    if (ext.glBufferStorage && !framesInFlightEnv.empty()) {
+        framesInFlight = std::max(static_cast<uint32_t>(std::strtoul(framesInFlightEnv.c_str(), nullptr, 10)), 1u);
+    }
+    frameFences.resize(framesInFlight, nullptr);
+    frameIndex = 0;
+
+    if (ext.glBufferStorage) {
+        GLint uniformBufferOffsetAlignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferOffsetAlignment);
+        transientUniformAlignment = std::max(static_cast<size_t>(uniformBufferOffsetAlignment), size_t(1));
+        transientUniformBuffer = (GLuint)(uint64_t)CreateBuffer({BufferCreateInfo::Type::UNIFORM, 0, transientUniformSegmentSize * frameFences.size(), nullptr, BufferCreateInfo::Usage::STREAM});
+        // CreateBuffer() has already reported a failed glMapBufferRange(). AllocateTransientUniformData() then stays disabled.
+        auto mappedBuffer = mappedBuffers.find(transientUniformBuffer);
+        if (mappedBuffer != mappedBuffers.end()) {
+            transientUniformMappedData = mappedBuffer->second;
+        }
+    }
+}
+
+void GraphicsAPI_OpenGL::DestroyStreamingResources() {
+    for (GLsync &fence : frameFences) {
+        if (fence) {
+            ext.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+            ext.glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (transientUniformBuffer) {
+        void *buffer = (void *)(uint64_t)transientUniformBuffer;
+        DestroyBuffer(buffer);
+        transientUniformBuffer = 0;
+        transientUniformMappedData = nullptr;
+    }
+}
+
 void *GraphicsAPI_OpenGL::CreateDesktopSwapchain(const SwapchainCreateInfo &swapchainCI) { return nullptr; }
 void GraphicsAPI_OpenGL::DestroyDesktopSwapchain(void *&swapchain) {}
 void *GraphicsAPI_OpenGL::GetDesktopSwapchainImage(void *swapchain, uint32_t index) { return nullptr; }
 void GraphicsAPI_OpenGL::AcquireDesktopSwapchanImage(void *swapchain, uint32_t &index) {}
 void GraphicsAPI_OpenGL::PresentDesktopSwapchainImage(void *swapchain, uint32_t index) {
+    if (headless) {
+        return;
+    }
 #if defined(XR_USE_PLATFORM_WIN32)
     SwapBuffers(window.hDC);
 #elif defined(XR_USE_PLATFORM_XLIB) || defined(XR_USE_PLATFORM_XCB)
@@ -511,6 +831,7 @@ void *GraphicsAPI_OpenGL::CreateImage(const ImageCreateInfo &imageCI) {
 
 void GraphicsAPI_OpenGL::DestroyImage(void *&image) {
     GLuint texture = (GLuint)(uint64_t)image;
+    DestroyFramebuffers(0, texture);
     images.erase(texture);
     glDeleteTextures(1, &texture);
     image = nullptr;
@@ -545,6 +866,7 @@ void *GraphicsAPI_OpenGL::CreateImageView(const ImageViewCreateInfo &imageViewCI
 
 void GraphicsAPI_OpenGL::DestroyImageView(void *&imageView) {
     GLuint framebuffer = (GLuint)(uint64_t)imageView;
+    DestroyFramebuffers(framebuffer, 0);
     imageViews.erase(framebuffer);
     glDeleteFramebuffers(1, &framebuffer);
     imageView = nullptr;
@@ -552,44 +874,38 @@ void GraphicsAPI_OpenGL::DestroyImageView(void *&imageView) {
 
 void *GraphicsAPI_OpenGL::CreateSampler(const SamplerCreateInfo &samplerCI) {
     GLuint sampler = 0;
-    PFNGLGENSAMPLERSPROC glGenSamplers = (PFNGLGENSAMPLERSPROC)GetExtension("glGenSamplers");  // 3.2+
-    glGenSamplers(1, &sampler);
-
-    PFNGLSAMPLERPARAMETERIPROC glSamplerParameteri = (PFNGLSAMPLERPARAMETERIPROC)GetExtension("glSamplerParameteri");      // 3.2+
-    PFNGLSAMPLERPARAMETERFPROC glSamplerParameterf = (PFNGLSAMPLERPARAMETERFPROC)GetExtension("glSamplerParameterf");      // 3.2+
-    PFNGLSAMPLERPARAMETERFVPROC glSamplerParameterfv = (PFNGLSAMPLERPARAMETERFVPROC)GetExtension("glSamplerParameterfv");  // 3.2+
+    ext.glGenSamplers(1, &sampler);
 
     // Filter
-    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, ToGLFilter(samplerCI.magFilter));
-    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, ToGLFilterMipmap(samplerCI.minFilter, samplerCI.mipmapMode));
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, ToGLFilter(samplerCI.magFilter));
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, ToGLFilterMipmap(samplerCI.minFilter, samplerCI.mipmapMode));
 
     // AddressMode
 
-    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, ToGLAddressMode(samplerCI.addressModeS));
-    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, ToGLAddressMode(samplerCI.addressModeT));
-    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, ToGLAddressMode(samplerCI.addressModeR));
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, ToGLAddressMode(samplerCI.addressModeS));
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, ToGLAddressMode(samplerCI.addressModeT));
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, ToGLAddressMode(samplerCI.addressModeR));
 
     // Lod Bias
-    glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, samplerCI.mipLodBias);
+    ext.glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, samplerCI.mipLodBias);
 
     // Compare
-    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, samplerCI.compareEnable ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE);
-    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, ToGLCompareOp(samplerCI.compareOp));
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, samplerCI.compareEnable ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE);
+    ext.glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, ToGLCompareOp(samplerCI.compareOp));
 
     // Lod
-    glSamplerParameterf(sampler, GL_TEXTURE_MIN_LOD, samplerCI.minLod);
-    glSamplerParameterf(sampler, GL_TEXTURE_MAX_LOD, samplerCI.maxLod);
+    ext.glSamplerParameterf(sampler, GL_TEXTURE_MIN_LOD, samplerCI.minLod);
+    ext.glSamplerParameterf(sampler, GL_TEXTURE_MAX_LOD, samplerCI.maxLod);
 
     // BorderColor
-    glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR, samplerCI.borderColor);
+    ext.glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR, samplerCI.borderColor);
 
     return (void *)(uint64_t)sampler;
 }
 
 void GraphicsAPI_OpenGL::DestroySampler(void *&sampler) {
     GLuint glsampler = (GLuint)(uint64_t)sampler;
-    PFNGLDELETESAMPLERSPROC glDeleteSamplers = (PFNGLDELETESAMPLERSPROC)GetExtension("glDeleteSamplers");  // 3.2+
-    glDeleteSamplers(1, &glsampler);
+    ext.glDeleteSamplers(1, &glsampler);
     sampler = nullptr;
 }
 
@@ -601,16 +917,35 @@ void *GraphicsAPI_OpenGL::CreateBuffer(const BufferCreateInfo &bufferCI) {
     if (bufferCI.type == BufferCreateInfo::Type::VERTEX) {
         target = GL_ARRAY_BUFFER;
     } else if (bufferCI.type == BufferCreateInfo::Type::INDEX) {
-        target = GL_ELEMENT_ARRAY_BUFFER;
+        target = GL_COPY_WRITE_BUFFER;  // Binding GL_ELEMENT_ARRAY_BUFFER would change the bound vertex array.
     } else if (bufferCI.type == BufferCreateInfo::Type::UNIFORM) {
         target = GL_UNIFORM_BUFFER;
+    } else if (bufferCI.type == BufferCreateInfo::Type::INDIRECT) {
+        target = GL_DRAW_INDIRECT_BUFFER;
     } else {
         DEBUG_BREAK;
         std::cout << "ERROR: OPENGL: Unknown Buffer Type." << std::endl;
     }
 
+    GLenum usage = GL_DYNAMIC_DRAW;
+    if (bufferCI.usage == BufferCreateInfo::Usage::STATIC) {
+        usage = GL_STATIC_DRAW;
+    } else if (bufferCI.usage == BufferCreateInfo::Usage::STREAM) {
+        usage = GL_STREAM_DRAW;
+    }
+
     glBindBuffer(target, buffer);
-    glBufferData(target, (GLsizeiptr)bufferCI.size, bufferCI.data, GL_STATIC_DRAW);
+    if (bufferCI.usage == BufferCreateInfo::Usage::STREAM && ext.glBufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        ext.glBufferStorage(target, (GLsizeiptr)bufferCI.size, bufferCI.data, flags);
+        mappedBuffers[buffer] = (char *)ext.glMapBufferRange(target, 0, (GLsizeiptr)bufferCI.size, flags);
+        if (!mappedBuffers[buffer]) {
+            std::cout << "ERROR: OPENGL: Failed to persistently map Buffer." << std::endl;
+            mappedBuffers.erase(buffer);
+        }
+    } else {
+        glBufferData(target, (GLsizeiptr)bufferCI.size, bufferCI.data, usage);
+    }
     glBindBuffer(target, 0);
 
     buffers[buffer] = bufferCI;
@@ -619,6 +954,8 @@ void *GraphicsAPI_OpenGL::CreateBuffer(const BufferCreateInfo &bufferCI) {
 
 void GraphicsAPI_OpenGL::DestroyBuffer(void *&buffer) {
     GLuint glBuffer = (GLuint)(uint64_t)buffer;
+    DestroyVertexArrays(0, glBuffer);
+    mappedBuffers.erase(glBuffer);  // glDeleteBuffers() unmaps the buffer.
     buffers.erase(glBuffer);
     glDeleteBuffers(1, &glBuffer);
     buffer = nullptr;
@@ -656,47 +993,119 @@ void *GraphicsAPI_OpenGL::CreateShader(const ShaderCreateInfo &shaderCI) {
     }
     GLuint shader = glCreateShader(type);
 
-    glShaderSource(shader, 1, &shaderCI.sourceData, nullptr);
-    glCompileShader(shader);
+    // The GLSL is shared with Vulkan. Its gl_VertexIndex is gl_VertexID in OpenGL, and drivers without GL_KHR_vulkan_glsl,
+    // such as Mesa's, reject the former.
+    std::string source(shaderCI.sourceData, shaderCI.sourceSize ? shaderCI.sourceSize : strlen(shaderCI.sourceData));
+    for (size_t pos = source.find("gl_VertexIndex"); pos != std::string::npos; pos = source.find("gl_VertexIndex", pos)) {
+        source.replace(pos, strlen("gl_VertexIndex"), "gl_VertexID");
+    }
 
-    GLint isCompiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
-    if (isCompiled == GL_FALSE) {
-        GLint maxLength = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+    // Compiling is deferred to CreatePipeline(), so that programs loaded from the program binary cache skip it.
+    const char *sourceData = source.c_str();
+    glShaderSource(shader, 1, &sourceData, nullptr);
+    shaders[shader] = {type, source, false};
 
-        std::vector<GLchar> infoLog(maxLength);
-        glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
-        std::cout << infoLog.data() << std::endl;
-        DEBUG_BREAK;
+    return (void *)(uint64_t)shader;
+}
 
-        glDeleteShader(shader);
-        shader = 0;
+void GraphicsAPI_OpenGL::CompileShader(GLuint shader) {
+    // The compile status isn't queried here, as that would wait for the compilation. FinishPipeline() reports errors.
+    ShaderInfo &shaderInfo = shaders[shader];
+    if (!shaderInfo.compiled) {
+        glCompileShader(shader);
+        shaderInfo.compiled = true;
     }
-
-    return (void *)(uint64_t)shader;
 }
 
 void GraphicsAPI_OpenGL::DestroyShader(void *&shader) {
     GLuint glShader = (GLuint)(uint64_t)shader;
+    shaders.erase(glShader);
     glDeleteShader(glShader);
     shader = nullptr;
 }
 
 void *GraphicsAPI_OpenGL::CreatePipeline(const PipelineCreateInfo &pipelineCI) {
-    GLuint program = glCreateProgram();
+    void *pipeline = CreatePipelineAsync(pipelineCI);
+    FinishPipeline((GLuint)(uint64_t)pipeline);
+    return pipeline;
+}
+
+void *GraphicsAPI_OpenGL::CreatePipelineAsync(const PipelineCreateInfo &pipelineCI) {
+    PendingProgram pendingProgram;
+    pendingProgram.start = std::chrono::steady_clock::now();
+    pendingProgram.binaryFileName = GetProgramBinaryFileName(pipelineCI);
 
-    for (const void *const &shader : pipelineCI.shaders)
-        glAttachShader(program, (GLuint)(uint64_t)shader);
+    GLuint program = pendingProgram.binaryFileName.empty() ? 0 : LoadProgramBinary(pendingProgram.binaryFileName);
+    if (program) {
+        programCacheHitCount++;
+        programCreationCount++;
+        programCreationMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pendingProgram.start).count();
+    } else {
+        program = glCreateProgram();
+
+        for (const void *const &shader : pipelineCI.shaders) {
+            CompileShader((GLuint)(uint64_t)shader);
+            glAttachShader(program, (GLuint)(uint64_t)shader);
+            pendingProgram.shaders.push_back((GLuint)(uint64_t)shader);
+        }
+
+        if (!pendingProgram.binaryFileName.empty()) {
+            ext.glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        // With KHR_parallel_shader_compile the driver links on its own threads. Nothing may query the program until
+        // GL_COMPLETION_STATUS_KHR is true, as that would wait for the link.
+        glLinkProgram(program);
+        pendingPrograms[program] = pendingProgram;
+    }
+
+    pipelines[program] = pipelineCI;
+
+    return (void *)(uint64_t)program;
+}
+
+bool GraphicsAPI_OpenGL::IsPipelineReady(void *pipeline) {
+    GLuint program = (GLuint)(uint64_t)pipeline;
+    if (pendingPrograms.find(program) == pendingPrograms.end()) {
+        return true;
+    }
+    if (ext.glMaxShaderCompilerThreadsKHR) {
+        GLint isCompleted = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &isCompleted);
+        if (isCompleted == GL_FALSE) {
+            return false;
+        }
+    }
+    FinishPipeline(program);
+    return true;
+}
 
-    glLinkProgram(program);
+void GraphicsAPI_OpenGL::FinishPipeline(GLuint program) {
+    auto it = pendingPrograms.find(program);
+    if (it == pendingPrograms.end()) {
+        return;
+    }
+    PendingProgram pendingProgram = std::move(it->second);
+    pendingPrograms.erase(it);
 
-    PFNGLVALIDATEPROGRAMPROC glValidateProgram = (PFNGLVALIDATEPROGRAMPROC)GetExtension("glValidateProgram");  // 2.0+
-    glValidateProgram(program);
+    ext.glValidateProgram(program);
 
     GLint isLinked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
     if (isLinked == GL_FALSE) {
+        for (const GLuint &shader : pendingProgram.shaders) {
+            GLint isCompiled = 0;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+            if (isCompiled == GL_FALSE) {
+                GLint maxLength = 0;
+                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+
+                std::vector<GLchar> infoLog(maxLength);
+                glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+                std::cout << infoLog.data() << std::endl;
+                DEBUG_BREAK;
+            }
+        }
+
         GLint maxLength = 0;
         glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
 
@@ -704,40 +1113,167 @@ void *GraphicsAPI_OpenGL::CreatePipeline(const PipelineCreateInfo &pipelineCI) {
         glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
 
         glDeleteProgram(program);
+    } else if (!pendingProgram.binaryFileName.empty()) {
+        SaveProgramBinary(program, pendingProgram.binaryFileName);
     }
 
-    PFNGLDETACHSHADERPROC glDetachShader = (PFNGLDETACHSHADERPROC)GetExtension("glDetachShader");  // 2.0+
-    for (const void *const &shader : pipelineCI.shaders)
-        glDetachShader(program, (GLuint)(uint64_t)shader);
+    for (const GLuint &shader : pendingProgram.shaders)
+        ext.glDetachShader(program, shader);
 
-    pipelines[program] = pipelineCI;
-
-    return (void *)(uint64_t)program;
+    programCreationCount++;
+    programCreationMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pendingProgram.start).count();
 }
 
 void GraphicsAPI_OpenGL::DestroyPipeline(void *&pipeline) {
     GLint program = (GLuint)(uint64_t)pipeline;
+    pendingPrograms.erase(program);
+    DestroyVertexArrays(program, 0);
+    if (shadowState.program.value == (GLuint)program) {
+        shadowState.program.generation = 0;
+    }
     pipelines.erase(program);
     glDeleteProgram(program);
     pipeline = nullptr;
 }
 
+void GraphicsAPI_OpenGL::CreateProgramBinaryCache() {
+    GLint binaryFormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+    if (!ext.glGetProgramBinary || !ext.glProgramBinary || !ext.glProgramParameteri || binaryFormatCount == 0) {
+        return;
+    }
+
+    std::string directory = GetEnv("XR_TUTORIAL_OPENGL_PROGRAM_CACHE_DIR");
+    programBinaryDirectory = directory.empty() ? "." : directory;
+
+    // Binaries are only valid for the driver that produced them, so its identity is part of every key.
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const char *string = (const char *)glGetString(name);
+        if (string) {
+            programBinaryDriverHash = HashFNV1a(string, strlen(string) + 1, programBinaryDriverHash);
+        }
+    }
+}
+
+void GraphicsAPI_OpenGL::DestroyProgramBinaryCache() {
+    std::cout << "OPENGL: Created " << programCreationCount << " programs in " << programCreationMs << " ms (until ready), "
+              << programCacheHitCount << " from the program binary cache." << std::endl;
+}
+
+std::string GraphicsAPI_OpenGL::GetProgramBinaryFileName(const PipelineCreateInfo &pipelineCI) {
+    if (programBinaryDirectory.empty()) {
+        return "";
+    }
+    uint64_t hash = programBinaryDriverHash;
+    for (const void *const &shader : pipelineCI.shaders) {
+        const ShaderInfo &shaderInfo = shaders[(GLuint)(uint64_t)shader];
+        hash = HashFNV1a(&shaderInfo.type, sizeof(shaderInfo.type), hash);
+        hash = HashFNV1a(shaderInfo.source.data(), shaderInfo.source.size(), hash);
+    }
+
+    std::stringstream fileName;
+    fileName << programBinaryDirectory << "/GLProgramBinary_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return fileName.str();
+}
+
+GLuint GraphicsAPI_OpenGL::LoadProgramBinary(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file || data.size() <= sizeof(GLenum)) {
+        return 0;
+    }
+
+    // The file holds the binary format, followed by the binary itself.
+    GLenum binaryFormat = 0;
+    memcpy(&binaryFormat, data.data(), sizeof(binaryFormat));
+    GLuint program = glCreateProgram();
+    ext.glProgramBinary(program, binaryFormat, data.data() + sizeof(binaryFormat), static_cast<GLsizei>(data.size() - sizeof(binaryFormat)));
+
+    GLint isLinked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if (isLinked == GL_FALSE) {
+        // The driver rejected the binary, e.g. after a driver update. It is rebuilt from source and overwritten.
+        std::cout << "WARNING: OPENGL: Ignoring incompatible program binary: " << fileName << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void GraphicsAPI_OpenGL::SaveProgramBinary(GLuint program, const std::string &fileName) {
+    GLint binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0) {
+        return;
+    }
+
+    GLenum binaryFormat = 0;
+    std::vector<char> data(sizeof(binaryFormat) + binaryLength);
+    ext.glGetProgramBinary(program, binaryLength, &binaryLength, &binaryFormat, data.data() + sizeof(binaryFormat));
+    memcpy(data.data(), &binaryFormat, sizeof(binaryFormat));
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), sizeof(binaryFormat) + binaryLength);
+    if (!file) {
+        std::cout << "WARNING: OPENGL: Failed to write program binary: " << fileName << std::endl;
+    }
+}
+
 void GraphicsAPI_OpenGL::BeginRendering() {
-    glGenVertexArrays(1, &vertexArray);
-    glBindVertexArray(vertexArray);
+    // Wait until the GPU has finished the submission that last used this frame's regions of the mapped buffers.
+    GLsync &fence = frameFences[frameIndex];
+    if (fence) {
+        GLenum result = ext.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        if (result == GL_WAIT_FAILED) {
+            std::cout << "ERROR: OPENGL: Failed to wait for frame Fence." << std::endl;
+        }
+        ext.glDeleteSync(fence);
+        fence = nullptr;
+    }
+    transientUniformOffset = 0;
 
-    glGenFramebuffers(1, &setFramebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, setFramebuffer);
+    if (!keepShadowStateUntilEndFrame) {
+        InvalidateShadowState();
+    }
+
+    timestampFrameIndex = (timestampFrameIndex + 1) % timestampFrames.size();
+    TimestampFrame &timestampFrame = timestampFrames[timestampFrameIndex];
+    ReadTimestampScopes(timestampFrame);
+    timestampFrame.submission = submissionCount++;
+    openTimestampScopes.clear();
 }
 
 void GraphicsAPI_OpenGL::EndRendering() {
+    while (!openTimestampScopes.empty()) {
+        EndTimestampScope();
+    }
+
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &setFramebuffer);
     setFramebuffer = 0;
 
+    if (!mappedBuffers.empty()) {
+        frameFences[frameIndex] = ext.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frameIndex = (frameIndex + 1) % frameFences.size();
+
     glBindVertexArray(0);
-    glDeleteVertexArrays(1, &vertexArray);
-    vertexArray = 0;
+    boundVertexArray = 0;
+}
+
+void GraphicsAPI_OpenGL::EndFrame() {
+    InvalidateShadowState();
+
+    if (benchmark && (++renderedFrames % 600) == 0) {
+        std::cout << "OPENGL: Pipeline state calls this frame: " << stateCallsIssued << " issued, " << stateCallsSkipped << " skipped, " << pipelinesSkipped << " SetPipeline() calls skipped entirely." << std::endl;
+    }
+    stateCallsIssued = 0;
+    stateCallsSkipped = 0;
+    pipelinesSkipped = 0;
 }
 
 void GraphicsAPI_OpenGL::SetBufferData(void *buffer, size_t offset, size_t size, void *data) {
@@ -748,26 +1284,99 @@ void GraphicsAPI_OpenGL::SetBufferData(void *buffer, size_t offset, size_t size,
     if (bufferCI.type == BufferCreateInfo::Type::VERTEX) {
         target = GL_ARRAY_BUFFER;
     } else if (bufferCI.type == BufferCreateInfo::Type::INDEX) {
-        target = GL_ELEMENT_ARRAY_BUFFER;
+        target = GL_COPY_WRITE_BUFFER;  // Binding GL_ELEMENT_ARRAY_BUFFER would change the bound vertex array.
     } else if (bufferCI.type == BufferCreateInfo::Type::UNIFORM) {
         target = GL_UNIFORM_BUFFER;
+    } else if (bufferCI.type == BufferCreateInfo::Type::INDIRECT) {
+        target = GL_DRAW_INDIRECT_BUFFER;
     } else {
         DEBUG_BREAK;
         std::cout << "ERROR: OPENGL: Unknown Buffer Type." << std::endl;
     }
 
-    if (data) {
+    auto mappedBuffer = mappedBuffers.find(glBuffer);
+    if (data && mappedBuffer != mappedBuffers.end()) {
+        // Coherently mapped, so the write is visible to the GPU without a flush.
+        memcpy(mappedBuffer->second + offset, data, size);
+    } else if (data) {
         glBindBuffer(target, glBuffer);
         glBufferSubData(target, (GLintptr)offset, (GLsizeiptr)size, data);
         glBindBuffer(target, 0);
     }
 }
 
+void GraphicsAPI_OpenGL::BeginTimestampScope(const char *name) {
+    TimestampFrame &timestampFrame = timestampFrames[timestampFrameIndex];
+    uint32_t index = static_cast<uint32_t>(timestampFrame.scopes.size());
+    if (!ext.glQueryCounter || index >= maxTimestampScopes) {
+        openTimestampScopes.push_back(UINT32_MAX);  // Not measured, but still has to be matched by EndTimestampScope().
+        return;
+    }
+    if (timestampFrame.queries.empty()) {
+        timestampFrame.queries.resize(2 * maxTimestampScopes);
+        glGenQueries(static_cast<GLsizei>(timestampFrame.queries.size()), timestampFrame.queries.data());
+    }
+    timestampFrame.scopes.push_back({name, static_cast<uint32_t>(openTimestampScopes.size()), 2 * index, 2 * index + 1});
+    openTimestampScopes.push_back(index);
+    ext.glQueryCounter(timestampFrame.queries[2 * index], GL_TIMESTAMP);
+}
+
+void GraphicsAPI_OpenGL::EndTimestampScope() {
+    if (openTimestampScopes.empty()) {
+        std::cout << "ERROR: OPENGL: EndTimestampScope() called without a matching BeginTimestampScope()." << std::endl;
+        return;
+    }
+    uint32_t index = openTimestampScopes.back();
+    openTimestampScopes.pop_back();
+    if (index != UINT32_MAX) {
+        TimestampFrame &timestampFrame = timestampFrames[timestampFrameIndex];
+        ext.glQueryCounter(timestampFrame.queries[timestampFrame.scopes[index].endQuery], GL_TIMESTAMP);
+    }
+}
+
+void GraphicsAPI_OpenGL::ReadTimestampScopes(TimestampFrame &timestampFrame) {
+    if (timestampScopeResults.size() > 4096) {
+        timestampScopeResults.clear();  // Nobody is collecting them.
+    }
+    for (const TimestampScope &scope : timestampFrame.scopes) {
+        GLuint beginQuery = timestampFrame.queries[scope.beginQuery];
+        GLuint endQuery = timestampFrame.queries[scope.endQuery];
+        GLuint beginAvailable = GL_FALSE;
+        GLuint endAvailable = GL_FALSE;
+        glGetQueryObjectuiv(beginQuery, GL_QUERY_RESULT_AVAILABLE, &beginAvailable);
+        glGetQueryObjectuiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &endAvailable);
+        if (beginAvailable && endAvailable) {
+            GLuint64 beginTime = 0;
+            GLuint64 endTime = 0;
+            ext.glGetQueryObjectui64v(beginQuery, GL_QUERY_RESULT, &beginTime);
+            ext.glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &endTime);
+            timestampScopeResults.push_back({scope.name, scope.depth, timestampFrame.submission, double(endTime - beginTime) / 1000000.0});
+        }
+    }
+    timestampFrame.scopes.clear();
+}
+
+GraphicsAPI::TransientBufferAllocation GraphicsAPI_OpenGL::AllocateTransientUniformData(size_t size) {
+    if (!transientUniformMappedData) {
+        return {nullptr, 0, nullptr};
+    }
+    size_t offset = Align(transientUniformOffset, transientUniformAlignment);
+    if (offset + size > transientUniformSegmentSize) {
+        std::cout << "ERROR: OPENGL: Out of transient uniform memory for this submission." << std::endl;
+        return {nullptr, 0, nullptr};
+    }
+    transientUniformOffset = offset + size;
+
+    size_t bufferOffset = transientUniformSegmentSize * frameIndex + offset;
+    return {(void *)(uint64_t)transientUniformBuffer, bufferOffset, transientUniformMappedData + bufferOffset};
+}
+
 void GraphicsAPI_OpenGL::ClearColor(void *imageView, float r, float g, float b, float a) {
     glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)(uint64_t)imageView);
     glClearColor(r, g, b, a);
     glClear(GL_COLOR_BUFFER_BIT);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    setFramebuffer = 0;
 }
 
 void GraphicsAPI_OpenGL::ClearDepth(void *imageView, float d) {
@@ -775,16 +1384,29 @@ void GraphicsAPI_OpenGL::ClearDepth(void *imageView, float d) {
     glClearDepth(d);
     glClear(GL_DEPTH_BUFFER_BIT);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    setFramebuffer = 0;
 }
 
 void GraphicsAPI_OpenGL::SetRenderAttachments(void **colorViews, size_t colorViewCount, void *depthStencilView, uint32_t width, uint32_t height, void *pipeline) {
-    // Reset Framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &setFramebuffer);
-    setFramebuffer = 0;
+    FramebufferKey key;
+    for (size_t i = 0; i < colorViewCount; i++) {
+        key.colorViews.push_back((GLuint)(uint64_t)colorViews[i]);
+    }
+    key.depthStencilView = (GLuint)(uint64_t)depthStencilView;
 
-    glGenFramebuffers(1, &setFramebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, setFramebuffer);
+    GLuint &framebuffer = framebufferCache[key];
+    if (framebuffer != 0) {
+        if (framebuffer != setFramebuffer) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            setFramebuffer = framebuffer;
+        }
+        return;
+    }
+
+    // First use of these attachments: create and validate a new framebuffer.
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    setFramebuffer = framebuffer;
 
     // Color
     for (size_t i = 0; i < colorViewCount; i++) {
@@ -825,238 +1447,246 @@ void GraphicsAPI_OpenGL::SetRenderAttachments(void **colorViews, size_t colorVie
 }
 
 void GraphicsAPI_OpenGL::SetViewports(Viewport *viewports, size_t count) {
-    PFNGLVIEWPORTINDEXEDFPROC glViewportIndexedf = (PFNGLVIEWPORTINDEXEDFPROC)GetExtension("glViewportIndexedf");      // 4.1+
-    PFNGLDEPTHRANGEINDEXEDPROC glDepthRangeIndexed = (PFNGLDEPTHRANGEINDEXEDPROC)GetExtension("glDepthRangeIndexed");  // 4.1+
-
     for (size_t i = 0; i < count; i++) {
         Viewport viewport = viewports[i];
-        glViewportIndexedf((GLuint)i, viewport.x, viewport.y, viewport.width, viewport.height);
-        glDepthRangeIndexed((GLuint)i, (GLdouble)viewport.minDepth, (GLdouble)viewport.maxDepth);
+        ext.glViewportIndexedf((GLuint)i, viewport.x, viewport.y, viewport.width, viewport.height);
+        ext.glDepthRangeIndexed((GLuint)i, (GLdouble)viewport.minDepth, (GLdouble)viewport.maxDepth);
     }
 }
 
 void GraphicsAPI_OpenGL::SetScissors(Rect2D *scissors, size_t count) {
-    PFNGLSCISSORINDEXEDPROC glScissorIndexed = (PFNGLSCISSORINDEXEDPROC)GetExtension("glScissorIndexed");  // 4.1+
-
     for (size_t i = 0; i < count; i++) {
         Rect2D scissor = scissors[i];
-        glScissorIndexed((GLuint)i, (GLint)scissor.offset.x, (GLint)scissor.offset.y, (GLsizei)scissor.extent.width, (GLsizei)scissor.extent.height);
+        ext.glScissorIndexed((GLuint)i, (GLint)scissor.offset.x, (GLint)scissor.offset.y, (GLsizei)scissor.extent.width, (GLsizei)scissor.extent.height);
     }
 }
 
+template <typename T>
+bool GraphicsAPI_OpenGL::UpdateShadow(Shadowed<T> &shadow, const T &value) {
+    if (shadow.generation == shadowGeneration && shadow.value == value) {
+        stateCallsSkipped++;
+        return false;
+    }
+    shadow.value = value;
+    shadow.generation = shadowGeneration;
+    stateCallsIssued++;
+    return true;
+}
+
 void GraphicsAPI_OpenGL::SetPipeline(void *pipeline) {
     GLuint program = (GLuint)(uint64_t)pipeline;
-    glUseProgram(program);
+    // Everything below only depends on the pipeline, so rebinding the current one is free.
+    if (shadowState.program.generation == shadowGeneration && shadowState.program.value == program) {
+        pipelinesSkipped++;
+        return;
+    }
+    FinishPipeline(program);
+    if (UpdateShadow(shadowState.program, program)) {
+        glUseProgram(program);
+    }
     setPipeline = program;
+    setVertexArrayKey.pipeline = program;
 
     const PipelineCreateInfo &pipelineCI = pipelines[program];
 
     // InputAssemblyState
     const InputAssemblyState &IAS = pipelineCI.inputAssemblyState;
-    if (IAS.primitiveRestartEnable) {
-        glEnable(GL_PRIMITIVE_RESTART);
-    } else {
-        glDisable(GL_PRIMITIVE_RESTART);
-    }
+    SetCapability(ShadowedCapability::PRIMITIVE_RESTART, GL_PRIMITIVE_RESTART, IAS.primitiveRestartEnable);
 
     // RasterisationState
     const RasterisationState &RS = pipelineCI.rasterisationState;
 
-    if (RS.depthClampEnable) {
-        glEnable(GL_DEPTH_CLAMP);
-    } else {
-        glDisable(GL_DEPTH_CLAMP);
-    }
-
-    if (RS.rasteriserDiscardEnable) {
-        glEnable(GL_RASTERIZER_DISCARD);
-    } else {
-        glDisable(GL_RASTERIZER_DISCARD);
-    }
+    SetCapability(ShadowedCapability::DEPTH_CLAMP, GL_DEPTH_CLAMP, RS.depthClampEnable);
+    SetCapability(ShadowedCapability::RASTERIZER_DISCARD, GL_RASTERIZER_DISCARD, RS.rasteriserDiscardEnable);
 
     if (RS.cullMode == CullMode::FRONT_AND_BACK) {
-        glPolygonMode(GL_FRONT_AND_BACK, ToGLPolygonMode(RS.polygonMode));
+        GLenum polygonMode = ToGLPolygonMode(RS.polygonMode);
+        if (UpdateShadow(shadowState.polygonMode, polygonMode)) {
+            glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
+        }
     }
 
     if (RS.cullMode > CullMode::NONE) {
-        glEnable(GL_CULL_FACE);
-        glCullFace(ToGLCullMode(RS.cullMode));
+        SetCapability(ShadowedCapability::CULL_FACE, GL_CULL_FACE, true);
+        GLenum cullMode = ToGLCullMode(RS.cullMode);
+        if (UpdateShadow(shadowState.cullFace, cullMode)) {
+            glCullFace(cullMode);
+        }
     } else {
-        glDisable(GL_CULL_FACE);
+        SetCapability(ShadowedCapability::CULL_FACE, GL_CULL_FACE, false);
     }
 
-    glFrontFace(RS.frontFace == FrontFace::COUNTER_CLOCKWISE ? GL_CCW : GL_CW);
+    GLenum frontFace = RS.frontFace == FrontFace::COUNTER_CLOCKWISE ? GL_CCW : GL_CW;
+    if (UpdateShadow(shadowState.frontFace, frontFace)) {
+        glFrontFace(frontFace);
+    }
 
     GLenum polygonOffsetMode = 0;
+    ShadowedCapability polygonOffsetCapability = ShadowedCapability::POLYGON_OFFSET_FILL;
     switch (RS.polygonMode) {
     default:
     case PolygonMode::FILL: {
         polygonOffsetMode = GL_POLYGON_OFFSET_FILL;
+        polygonOffsetCapability = ShadowedCapability::POLYGON_OFFSET_FILL;
         break;
     }
     case PolygonMode::LINE: {
         polygonOffsetMode = GL_POLYGON_OFFSET_LINE;
+        polygonOffsetCapability = ShadowedCapability::POLYGON_OFFSET_LINE;
         break;
     }
     case PolygonMode::POINT: {
         polygonOffsetMode = GL_POLYGON_OFFSET_POINT;
+        polygonOffsetCapability = ShadowedCapability::POLYGON_OFFSET_POINT;
         break;
     }
     }
     if (RS.depthBiasEnable) {
-        glEnable(polygonOffsetMode);
+        SetCapability(polygonOffsetCapability, polygonOffsetMode, true);
         // glPolygonOffsetClamp
-        glPolygonOffset(RS.depthBiasSlopeFactor, RS.depthBiasConstantFactor);
+        if (UpdateShadow(shadowState.polygonOffset, {RS.depthBiasSlopeFactor, RS.depthBiasConstantFactor})) {
+            glPolygonOffset(RS.depthBiasSlopeFactor, RS.depthBiasConstantFactor);
+        }
     } else {
-        glDisable(polygonOffsetMode);
+        SetCapability(polygonOffsetCapability, polygonOffsetMode, false);
     }
 
-    glLineWidth(RS.lineWidth);
+    if (UpdateShadow(shadowState.lineWidth, RS.lineWidth)) {
+        glLineWidth(RS.lineWidth);
+    }
 
     // MultisampleState
     const MultisampleState &MS = pipelineCI.multisampleState;
 
-    if (MS.rasterisationSamples > 1) {
-        glEnable(GL_MULTISAMPLE);
-    } else {
-        glDisable(GL_MULTISAMPLE);
-    }
+    SetCapability(ShadowedCapability::MULTISAMPLE, GL_MULTISAMPLE, MS.rasterisationSamples > 1);
 
     if (MS.sampleShadingEnable) {
-        glEnable(GL_SAMPLE_SHADING);
-        PFNGLMINSAMPLESHADINGPROC glMinSampleShading = (PFNGLMINSAMPLESHADINGPROC)GetExtension("glMinSampleShading");  // 4.0+
-        glMinSampleShading(MS.minSampleShading);
+        SetCapability(ShadowedCapability::SAMPLE_SHADING, GL_SAMPLE_SHADING, true);
+        if (UpdateShadow(shadowState.minSampleShading, MS.minSampleShading)) {
+            ext.glMinSampleShading(MS.minSampleShading);
+        }
     } else {
-        glDisable(GL_SAMPLE_SHADING);
+        SetCapability(ShadowedCapability::SAMPLE_SHADING, GL_SAMPLE_SHADING, false);
     }
 
     if (MS.sampleMask > 0) {
-        glEnable(GL_SAMPLE_MASK);
-        PFNGLSAMPLEMASKIPROC glSampleMaski = (PFNGLSAMPLEMASKIPROC)GetExtension("glSampleMaski");  // 3.2+
-        glSampleMaski(0, MS.sampleMask);
-    } else {
-        glDisable(GL_SAMPLE_MASK);
-    }
-
-    if (MS.alphaToCoverageEnable) {
-        glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        SetCapability(ShadowedCapability::SAMPLE_MASK, GL_SAMPLE_MASK, true);
+        if (UpdateShadow(shadowState.sampleMask, MS.sampleMask)) {
+            ext.glSampleMaski(0, MS.sampleMask);
+        }
     } else {
-        glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        SetCapability(ShadowedCapability::SAMPLE_MASK, GL_SAMPLE_MASK, false);
     }
 
-    if (MS.alphaToOneEnable) {
-        glEnable(GL_SAMPLE_ALPHA_TO_ONE);
-    } else {
-        glDisable(GL_SAMPLE_ALPHA_TO_ONE);
-    }
+    SetCapability(ShadowedCapability::SAMPLE_ALPHA_TO_COVERAGE, GL_SAMPLE_ALPHA_TO_COVERAGE, MS.alphaToCoverageEnable);
+    SetCapability(ShadowedCapability::SAMPLE_ALPHA_TO_ONE, GL_SAMPLE_ALPHA_TO_ONE, MS.alphaToOneEnable);
 
     // DepthStencilState
     const DepthStencilState &DSS = pipelineCI.depthStencilState;
 
-    if (DSS.depthTestEnable) {
-        glEnable(GL_DEPTH_TEST);
-    } else {
-        glDisable(GL_DEPTH_TEST);
-    }
+    SetCapability(ShadowedCapability::DEPTH_TEST, GL_DEPTH_TEST, DSS.depthTestEnable);
 
-    glDepthMask(DSS.depthWriteEnable ? GL_TRUE : GL_FALSE);
+    if (UpdateShadow(shadowState.depthMask, DSS.depthWriteEnable)) {
+        glDepthMask(DSS.depthWriteEnable ? GL_TRUE : GL_FALSE);
+    }
 
-    glDepthFunc(ToGLCompareOp(DSS.depthCompareOp));
+    GLenum depthFunc = ToGLCompareOp(DSS.depthCompareOp);
+    if (UpdateShadow(shadowState.depthFunc, depthFunc)) {
+        glDepthFunc(depthFunc);
+    }
 
-    PFNGLDEPTHBOUNDSEXTPROC glDepthBoundsEXT = (PFNGLDEPTHBOUNDSEXTPROC)GetExtension("glDepthBoundsEXT");  // EXT
-    if (glDepthBoundsEXT) {
+    if (ext.glDepthBoundsEXT) {
         if (DSS.depthBoundsTestEnable) {
-            glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
-            glDepthBoundsEXT(DSS.minDepthBounds, DSS.maxDepthBounds);
+            SetCapability(ShadowedCapability::DEPTH_BOUNDS_TEST, GL_DEPTH_BOUNDS_TEST_EXT, true);
+            if (UpdateShadow(shadowState.depthBounds, {DSS.minDepthBounds, DSS.maxDepthBounds})) {
+                ext.glDepthBoundsEXT(DSS.minDepthBounds, DSS.maxDepthBounds);
+            }
         } else {
-            glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+            SetCapability(ShadowedCapability::DEPTH_BOUNDS_TEST, GL_DEPTH_BOUNDS_TEST_EXT, false);
         }
     }
 
-    if (DSS.stencilTestEnable) {
-        glEnable(GL_STENCIL_TEST);
-    } else {
-        glDisable(GL_STENCIL_TEST);
-    }
-
-    PFNGLSTENCILOPSEPARATEPROC glStencilOpSeparate = (PFNGLSTENCILOPSEPARATEPROC)GetExtension("glStencilOpSeparate");          // 2.0+
-    PFNGLSTENCILFUNCSEPARATEPROC glStencilFuncSeparate = (PFNGLSTENCILFUNCSEPARATEPROC)GetExtension("glStencilFuncSeparate");  // 2.0+
-    PFNGLSTENCILMASKSEPARATEPROC glStencilMaskSeparate = (PFNGLSTENCILMASKSEPARATEPROC)GetExtension("glStencilMaskSeparate");  // 2.0+
-
-    glStencilOpSeparate(GL_FRONT,
-                        ToGLStencilCompareOp(DSS.front.failOp),
-                        ToGLStencilCompareOp(DSS.front.depthFailOp),
-                        ToGLStencilCompareOp(DSS.front.passOp));
-    glStencilFuncSeparate(GL_FRONT,
-                          ToGLCompareOp(DSS.front.compareOp),
-                          DSS.front.reference,
-                          DSS.front.compareMask);
-    glStencilMaskSeparate(GL_FRONT, DSS.front.writeMask);
-
-    glStencilOpSeparate(GL_BACK,
-                        ToGLStencilCompareOp(DSS.back.failOp),
-                        ToGLStencilCompareOp(DSS.back.depthFailOp),
-                        ToGLStencilCompareOp(DSS.back.passOp));
-    glStencilFuncSeparate(GL_BACK,
-                          ToGLCompareOp(DSS.back.compareOp),
-                          DSS.back.reference,
-                          DSS.back.compareMask);
-    glStencilMaskSeparate(GL_BACK, DSS.back.writeMask);
+    SetCapability(ShadowedCapability::STENCIL_TEST, GL_STENCIL_TEST, DSS.stencilTestEnable);
+
+    const std::pair<GLenum, const StencilOpState &> stencilFaces[2] = {{GL_FRONT, DSS.front}, {GL_BACK, DSS.back}};
+    for (int i = 0; i < 2; i++) {
+        const GLenum &face = stencilFaces[i].first;
+        const StencilOpState &SOS = stencilFaces[i].second;
+
+        GLenum failOp = ToGLStencilCompareOp(SOS.failOp);
+        GLenum depthFailOp = ToGLStencilCompareOp(SOS.depthFailOp);
+        GLenum passOp = ToGLStencilCompareOp(SOS.passOp);
+        if (UpdateShadow(shadowState.stencilOp[i], {failOp, depthFailOp, passOp})) {
+            ext.glStencilOpSeparate(face, failOp, depthFailOp, passOp);
+        }
+
+        GLenum compareOp = ToGLCompareOp(SOS.compareOp);
+        if (UpdateShadow(shadowState.stencilFunc[i], {compareOp, SOS.reference, SOS.compareMask})) {
+            ext.glStencilFuncSeparate(face, compareOp, SOS.reference, SOS.compareMask);
+        }
+
+        if (UpdateShadow(shadowState.stencilWriteMask[i], SOS.writeMask)) {
+            ext.glStencilMaskSeparate(face, SOS.writeMask);
+        }
+    }
 
     // ColorBlendState
     const ColorBlendState &CBS = pipelineCI.colorBlendState;
 
     if (CBS.logicOpEnable) {
-        glEnable(GL_COLOR_LOGIC_OP);
-        glLogicOp(ToGLLogicOp(CBS.logicOp));
+        SetCapability(ShadowedCapability::COLOR_LOGIC_OP, GL_COLOR_LOGIC_OP, true);
+        GLenum logicOp = ToGLLogicOp(CBS.logicOp);
+        if (UpdateShadow(shadowState.logicOp, logicOp)) {
+            glLogicOp(logicOp);
+        }
     } else {
-        glDisable(GL_COLOR_LOGIC_OP);
+        SetCapability(ShadowedCapability::COLOR_LOGIC_OP, GL_COLOR_LOGIC_OP, false);
     }
 
     for (int i = 0; i < (int)CBS.attachments.size(); i++) {
         const ColorBlendAttachmentState &CBA = CBS.attachments[i];
+        // Attachments beyond the shadowed ones are always applied.
+        const bool shadowed = i < (int)maxShadowedAttachments;
 
-        PFNGLENABLEIPROC glEnablei = (PFNGLENABLEIPROC)GetExtension("glEnablei");                                                              // 3.0+
-        PFNGLDISABLEIPROC glDisablei = (PFNGLDISABLEIPROC)GetExtension("glDisablei");                                                          // 3.0+
-        PFNGLBLENDEQUATIONSEPARATEIPROC glBlendEquationSeparatei = (PFNGLBLENDEQUATIONSEPARATEIPROC)GetExtension("glBlendEquationSeparatei");  // 4.0+
-        PFNGLBLENDFUNCSEPARATEIPROC glBlendFuncSeparatei = (PFNGLBLENDFUNCSEPARATEIPROC)GetExtension("glBlendFuncSeparatei");                  // 4.0+
-        PFNGLCOLORMASKIPROC glColorMaski = (PFNGLCOLORMASKIPROC)GetExtension("glColorMaski");                                                  // 3.0+
+        SetBlendEnabled(i, CBA.blendEnable);
 
-        if (CBA.blendEnable) {
-            glEnablei(GL_BLEND, i);
-        } else {
-            glDisablei(GL_BLEND, i);
+        GLenum colorBlendOp = ToGLBlendOp(CBA.colorBlendOp);
+        GLenum alphaBlendOp = ToGLBlendOp(CBA.alphaBlendOp);
+        if (!shadowed || UpdateShadow(shadowState.blendEquation[i], {colorBlendOp, alphaBlendOp})) {
+            ext.glBlendEquationSeparatei(i, colorBlendOp, alphaBlendOp);
         }
 
-        glBlendEquationSeparatei(i, ToGLBlendOp(CBA.colorBlendOp), ToGLBlendOp(CBA.alphaBlendOp));
-
-        glBlendFuncSeparatei(i,
-                             ToGLBlendFactor(CBA.srcColorBlendFactor),
-                             ToGLBlendFactor(CBA.dstColorBlendFactor),
-                             ToGLBlendFactor(CBA.srcAlphaBlendFactor),
-                             ToGLBlendFactor(CBA.dstAlphaBlendFactor));
+        GLenum srcColorBlendFactor = ToGLBlendFactor(CBA.srcColorBlendFactor);
+        GLenum dstColorBlendFactor = ToGLBlendFactor(CBA.dstColorBlendFactor);
+        GLenum srcAlphaBlendFactor = ToGLBlendFactor(CBA.srcAlphaBlendFactor);
+        GLenum dstAlphaBlendFactor = ToGLBlendFactor(CBA.dstAlphaBlendFactor);
+        if (!shadowed || UpdateShadow(shadowState.blendFunc[i], {srcColorBlendFactor, dstColorBlendFactor, srcAlphaBlendFactor, dstAlphaBlendFactor})) {
+            ext.glBlendFuncSeparatei(i, srcColorBlendFactor, dstColorBlendFactor, srcAlphaBlendFactor, dstAlphaBlendFactor);
+        }
 
-        glColorMaski(i,
-                     (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::R_BIT) == (uint32_t)ColorComponentBit::R_BIT),
-                     (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::G_BIT) == (uint32_t)ColorComponentBit::G_BIT),
-                     (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::B_BIT) == (uint32_t)ColorComponentBit::B_BIT),
-                     (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::A_BIT) == (uint32_t)ColorComponentBit::A_BIT));
+        if (!shadowed || UpdateShadow(shadowState.colorWriteMask[i], (uint32_t)CBA.colorWriteMask)) {
+            ext.glColorMaski(i,
+                             (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::R_BIT) == (uint32_t)ColorComponentBit::R_BIT),
+                             (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::G_BIT) == (uint32_t)ColorComponentBit::G_BIT),
+                             (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::B_BIT) == (uint32_t)ColorComponentBit::B_BIT),
+                             (((uint32_t)CBA.colorWriteMask & (uint32_t)ColorComponentBit::A_BIT) == (uint32_t)ColorComponentBit::A_BIT));
+        }
+    }
+    if (UpdateShadow(shadowState.blendColor, {CBS.blendConstants[0], CBS.blendConstants[1], CBS.blendConstants[2], CBS.blendConstants[3]})) {
+        glBlendColor(CBS.blendConstants[0], CBS.blendConstants[1], CBS.blendConstants[2], CBS.blendConstants[3]);
     }
-    glBlendColor(CBS.blendConstants[0], CBS.blendConstants[1], CBS.blendConstants[2], CBS.blendConstants[3]);
 }
 
 void GraphicsAPI_OpenGL::SetDescriptor(const DescriptorInfo &descriptorInfo) {
     GLuint glResource = (GLuint)(uint64_t)descriptorInfo.resource;
     const GLuint &bindingIndex = descriptorInfo.bindingIndex;
     if (descriptorInfo.type == DescriptorInfo::Type::BUFFER) {
-        PFNGLBINDBUFFERRANGEPROC glBindBufferRange = (PFNGLBINDBUFFERRANGEPROC)GetExtension("glBindBufferRange");  // 3.0+
-        glBindBufferRange(GL_UNIFORM_BUFFER, bindingIndex, glResource, (GLintptr)descriptorInfo.bufferOffset, (GLsizeiptr)descriptorInfo.bufferSize);
+        ext.glBindBufferRange(GL_UNIFORM_BUFFER, bindingIndex, glResource, (GLintptr)descriptorInfo.bufferOffset, (GLsizeiptr)descriptorInfo.bufferSize);
     } else if (descriptorInfo.type == DescriptorInfo::Type::IMAGE) {
         glActiveTexture(GL_TEXTURE0 + bindingIndex);
         glBindTexture(GetGLTextureTarget(images[glResource]), glResource);
     } else if (descriptorInfo.type == DescriptorInfo::Type::SAMPLER) {
-        PFNGLBINDSAMPLERPROC glBindSampler = (PFNGLBINDSAMPLERPROC)GetExtension("glBindSampler");  // 3.0+
-        glBindSampler(bindingIndex, glResource);
+        ext.glBindSampler(bindingIndex, glResource);
     } else {
         std::cout << "ERROR: OPENGL: Unknown Descriptor Type." << std::endl;
     }
@@ -1066,14 +1696,44 @@ void GraphicsAPI_OpenGL::UpdateDescriptors() {
 }
 
 void GraphicsAPI_OpenGL::SetVertexBuffers(void **vertexBuffers, size_t count) {
-    const VertexInputState &vertexInputState = pipelines[setPipeline].vertexInputState;
+    setVertexArrayKey.vertexBuffers.resize(count);
     for (size_t i = 0; i < count; i++) {
         GLuint glVertexBufferID = (GLuint)(uint64_t)vertexBuffers[i];
         if (buffers[glVertexBufferID].type != BufferCreateInfo::Type::VERTEX) {
             std::cout << "ERROR: OpenGL: Provided buffer is not type: VERTEX." << std::endl;
         }
+        setVertexArrayKey.vertexBuffers[i] = glVertexBufferID;
+    }
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, (GLuint)(uint64_t)vertexBuffers[i]);
+size_t GraphicsAPI_OpenGL::VertexArrayKeyHash::operator()(const VertexArrayKey &key) const {
+    size_t hash = std::hash<GLuint>()(key.pipeline);
+    for (const GLuint &vertexBuffer : key.vertexBuffers) {
+        HashCombine(hash, vertexBuffer);
+    }
+    HashCombine(hash, key.indexBuffer);
+    return hash;
+}
+
+void GraphicsAPI_OpenGL::BindVertexArray() {
+    GLuint &vertexArray = vertexArrayCache[setVertexArrayKey];
+    if (vertexArray != 0) {
+        if (vertexArray != boundVertexArray) {
+            glBindVertexArray(vertexArray);
+            boundVertexArray = vertexArray;
+        }
+        return;
+    }
+
+    // First use of this combination: record the attribute layout and the index buffer into a new vertex array.
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    boundVertexArray = vertexArray;
+
+    const VertexInputState &vertexInputState = pipelines[setPipeline].vertexInputState;
+    const std::vector<GLuint> &vertexBuffers = setVertexArrayKey.vertexBuffers;
+    for (size_t i = 0; i < vertexBuffers.size(); i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[i]);
 
         // https://i.redd.it/fyxp5ah06a661.png
         for (const VertexInputBinding &vertexBinding : vertexInputState.bindings) {
@@ -1088,11 +1748,105 @@ void GraphicsAPI_OpenGL::SetVertexBuffers(void **vertexBuffers, size_t count) {
                         const void *offset = (const void *)vertexAttribute.offset;
                         glEnableVertexAttribArray(attribIndex);
                         glVertexAttribPointer(attribIndex, size, type, false, stride, offset);
+                        glVertexAttribDivisor(attribIndex, vertexBinding.inputRate == VertexInputRate::PER_INSTANCE ? 1 : 0);
                     }
                 }
             }
         }
     }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, setVertexArrayKey.indexBuffer);
+}
+
+void GraphicsAPI_OpenGL::DestroyVertexArrays(GLuint pipeline, GLuint buffer) {
+    for (auto it = vertexArrayCache.begin(); it != vertexArrayCache.end();) {
+        const VertexArrayKey &key = it->first;
+        bool usesBuffer = buffer != 0 && (key.indexBuffer == buffer || std::find(key.vertexBuffers.begin(), key.vertexBuffers.end(), buffer) != key.vertexBuffers.end());
+        if ((pipeline != 0 && key.pipeline == pipeline) || usesBuffer) {
+            if (it->second == boundVertexArray) {
+                glBindVertexArray(0);
+                boundVertexArray = 0;
+            }
+            glDeleteVertexArrays(1, &it->second);
+            it = vertexArrayCache.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+void GraphicsAPI_OpenGL::InvalidateShadowState() {
+    shadowGeneration++;
+    shadowState.capabilitiesKnown.reset();
+    shadowState.blendEnabledKnown.reset();
+}
+
+void GraphicsAPI_OpenGL::SetCapability(ShadowedCapability capability, GLenum glCapability, bool enable) {
+    const size_t bit = (size_t)capability;
+    if (shadowState.capabilitiesKnown[bit] && shadowState.capabilities[bit] == enable) {
+        stateCallsSkipped++;
+        return;
+    }
+    shadowState.capabilitiesKnown[bit] = true;
+    shadowState.capabilities[bit] = enable;
+    stateCallsIssued++;
+    if (enable) {
+        glEnable(glCapability);
+    } else {
+        glDisable(glCapability);
+    }
+}
+
+void GraphicsAPI_OpenGL::SetBlendEnabled(GLuint index, bool enable) {
+    if (index < maxShadowedAttachments) {
+        if (shadowState.blendEnabledKnown[index] && shadowState.blendEnabled[index] == enable) {
+            stateCallsSkipped++;
+            return;
+        }
+        shadowState.blendEnabledKnown[index] = true;
+        shadowState.blendEnabled[index] = enable;
+    }
+    stateCallsIssued++;
+    if (enable) {
+        ext.glEnablei(GL_BLEND, index);
+    } else {
+        ext.glDisablei(GL_BLEND, index);
+    }
+}
+
+size_t GraphicsAPI_OpenGL::FramebufferKeyHash::operator()(const FramebufferKey &key) const {
+    size_t hash = std::hash<GLuint>()(key.depthStencilView);
+    for (const GLuint &colorView : key.colorViews) {
+        HashCombine(hash, colorView);
+    }
+    return hash;
+}
+
+void GraphicsAPI_OpenGL::DestroyFramebuffers(GLuint imageView, GLuint image) {
+    auto references = [&](GLuint view) {
+        if (view == 0) {
+            return false;
+        }
+        if (imageView != 0 && view == imageView) {
+            return true;
+        }
+        auto it = imageViews.find(view);
+        return image != 0 && it != imageViews.end() && (GLuint)(uint64_t)it->second.image == image;
+    };
+
+    for (auto it = framebufferCache.begin(); it != framebufferCache.end();) {
+        const FramebufferKey &key = it->first;
+        if (references(key.depthStencilView) || std::any_of(key.colorViews.begin(), key.colorViews.end(), references)) {
+            if (it->second == setFramebuffer) {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                setFramebuffer = 0;
+            }
+            glDeleteFramebuffers(1, &it->second);
+            it = framebufferCache.erase(it);
+        } else {
+            it++;
+        }
+    }
 }
 
 void GraphicsAPI_OpenGL::SetIndexBuffer(void *indexBuffer) {
@@ -1100,19 +1854,38 @@ void GraphicsAPI_OpenGL::SetIndexBuffer(void *indexBuffer) {
     if (buffers[glIndexBufferID].type != BufferCreateInfo::Type::INDEX) {
         std::cout << "ERROR: OpenGL: Provided buffer is not type: INDEX." << std::endl;
     }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glIndexBufferID);
     setIndexBuffer = glIndexBufferID;
+    setVertexArrayKey.indexBuffer = glIndexBufferID;
 }
 
 void GraphicsAPI_OpenGL::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
-    PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC glDrawElementsInstancedBaseVertexBaseInstance = (PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)GetExtension("glDrawElementsInstancedBaseVertexBaseInstance");  // 4.2+
+    BindVertexArray();
     GLenum indexType = buffers[setIndexBuffer].stride == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
-    glDrawElementsInstancedBaseVertexBaseInstance(ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology), indexCount, indexType, nullptr, instanceCount, vertexOffset, firstInstance);
+    ext.glDrawElementsInstancedBaseVertexBaseInstance(ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology), indexCount, indexType, nullptr, instanceCount, vertexOffset, firstInstance);
+}
+
+void GraphicsAPI_OpenGL::DrawIndexedIndirect(void *indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    if (!stride) {
+        stride = sizeof(DrawIndexedIndirectCommand);
+    }
+    BindVertexArray();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, (GLuint)(size_t)indirectBuffer);
+    GLenum mode = ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology);
+    GLenum indexType = buffers[setIndexBuffer].stride == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    if (ext.glMultiDrawElementsIndirect) {
+        ext.glMultiDrawElementsIndirect(mode, indexType, (const void *)offset, (GLsizei)drawCount, (GLsizei)stride);
+    } else if (ext.glDrawElementsIndirect) {
+        for (uint32_t i = 0; i < drawCount; i++) {
+            ext.glDrawElementsIndirect(mode, indexType, (const void *)(offset + (size_t)i * stride));
+        }
+    } else {
+        std::cout << "ERROR: OPENGL: DrawIndexedIndirect() requires OpenGL 4.0 or GL_ARB_draw_indirect." << std::endl;
+    }
 }
 
 void GraphicsAPI_OpenGL::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
-    PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC glDrawArraysInstancedBaseInstance = (PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC)GetExtension("glDrawArraysInstancedBaseInstance");  // 4.2+
-    glDrawArraysInstancedBaseInstance(ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology), firstVertex, vertexCount, instanceCount, firstInstance);
+    BindVertexArray();
+    ext.glDrawArraysInstancedBaseInstance(ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology), firstVertex, vertexCount, instanceCount, firstInstance);
 }
 
 // XR_DOCS_TAG_BEGIN_GraphicsAPI_OpenGL_GetSupportedSwapchainFormats
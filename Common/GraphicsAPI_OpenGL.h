@@ -7,13 +7,41 @@
 #pragma once
 #include <GraphicsAPI.h>
 
+#include <array>
+#include <bitset>
+
 #if defined(XR_USE_GRAPHICS_API_OPENGL)
+// KHR_parallel_shader_compile isn't part of the generated glad headers.
+#if !defined(GL_KHR_parallel_shader_compile)
+#define GL_KHR_parallel_shader_compile 1
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void(GLAD_API_PTR *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
+
+// Headless contexts are created through EGL, which glad already loads on Linux.
+#if defined(OS_LINUX)
+#define XR_TUTORIAL_OPENGL_HEADLESS_EGL 1
+#include <glad/egl.h>
+#if !defined(EGL_PLATFORM_SURFACELESS_MESA)
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
 class GraphicsAPI_OpenGL : public GraphicsAPI {
 public:
-    GraphicsAPI_OpenGL();
+    // A headless context has no window, nor any swapchain, and renders only to images created with CreateImage().
+    // Check IsContextCreated() before use: when the context couldn't be created, no other member may be called.
+    explicit GraphicsAPI_OpenGL(bool headless = false);
     GraphicsAPI_OpenGL(XrInstance m_xrInstance, XrSystemId systemId);
     ~GraphicsAPI_OpenGL();
 
+    bool IsContextCreated() const { return contextCreated; }
+    // The runtime may use the context in any xr*Swapchain*() call and in xrEndFrame(), so by default the shadowed pipeline
+    // state is dropped in every BeginRendering(). Contexts that no runtime uses, such as headless ones, may keep it until
+    // EndFrame() instead.
+    void SetKeepShadowStateUntilEndFrame(bool keep) { keepShadowStateUntilEndFrame = keep; }
+
     virtual void* CreateDesktopSwapchain(const SwapchainCreateInfo& swapchainCI) override;
     virtual void DestroyDesktopSwapchain(void*& swapchain) override;
     virtual void* GetDesktopSwapchainImage(void* swapchain, uint32_t index) override;
@@ -53,11 +81,21 @@ public:
     virtual void* CreatePipeline(const PipelineCreateInfo& pipelineCI) override;
     virtual void DestroyPipeline(void*& pipeline) override;
 
+    virtual void* CreatePipelineAsync(const PipelineCreateInfo& pipelineCI) override;
+    virtual bool IsPipelineReady(void* pipeline) override;
+
     virtual void BeginRendering() override;
     virtual void EndRendering() override;
+    virtual void EndFrame() override;
+
+    virtual uint32_t GetFramesInFlight() override { return static_cast<uint32_t>(frameFences.size()); }
+    virtual TransientBufferAllocation AllocateTransientUniformData(size_t size) override;
 
     virtual void SetBufferData(void* buffer, size_t offset, size_t size, void* data) override;
 
+    virtual void BeginTimestampScope(const char* name) override;
+    virtual void EndTimestampScope() override;
+
     virtual void ClearColor(void* imageView, float r, float g, float b, float a) override;
     virtual void ClearDepth(void* imageView, float d) override;
 
@@ -72,13 +110,119 @@ public:
     virtual void SetIndexBuffer(void* indexBuffer) override;
     virtual void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0) override;
     virtual void Draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0) override;
+    virtual void DrawIndexedIndirect(void* indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride = 0) override;
 
 private:
+    bool CreateHeadlessContext();
+    void DestroyHeadlessContext();
+
+    void LoadExtensionFunctions(GLint majorVersion, GLint minorVersion);
+    bool IsExtensionSupported(const char* name);
+    void BenchmarkExtensionFunctions();
+
+    void CreateStreamingResources();
+    void DestroyStreamingResources();
+
+    void CreateProgramBinaryCache();
+    void DestroyProgramBinaryCache();
+    std::string GetProgramBinaryFileName(const PipelineCreateInfo& pipelineCI);
+    GLuint LoadProgramBinary(const std::string& fileName);
+    void SaveProgramBinary(GLuint program, const std::string& fileName);
+    void CompileShader(GLuint shader);
+    void FinishPipeline(GLuint program);
+
+    void BindVertexArray();
+    void DestroyVertexArrays(GLuint pipeline, GLuint buffer);
+
+    void DestroyFramebuffers(GLuint imageView, GLuint image);
+
+    // The capabilities that SetPipeline() toggles, as bits of ShadowState::capabilities.
+    enum class ShadowedCapability : uint32_t {
+        PRIMITIVE_RESTART,
+        DEPTH_CLAMP,
+        RASTERIZER_DISCARD,
+        CULL_FACE,
+        POLYGON_OFFSET_FILL,
+        POLYGON_OFFSET_LINE,
+        POLYGON_OFFSET_POINT,
+        MULTISAMPLE,
+        SAMPLE_SHADING,
+        SAMPLE_MASK,
+        SAMPLE_ALPHA_TO_COVERAGE,
+        SAMPLE_ALPHA_TO_ONE,
+        DEPTH_TEST,
+        DEPTH_BOUNDS_TEST,
+        STENCIL_TEST,
+        COLOR_LOGIC_OP,
+        COUNT
+    };
+    template <typename T>
+    struct Shadowed {
+        T value{};
+        uint32_t generation = 0;  // Only trusted while equal to shadowGeneration.
+    };
+    template <typename T>
+    bool UpdateShadow(Shadowed<T>& shadow, const T& value);
+    void SetCapability(ShadowedCapability capability, GLenum glCapability, bool enable);
+    void SetBlendEnabled(GLuint index, bool enable);
+    void InvalidateShadowState();
+
     virtual const std::vector<int64_t> GetSupportedColorSwapchainFormats() override;
     virtual const std::vector<int64_t> GetSupportedDepthSwapchainFormats() override;
 
 private:
     ksGpuWindow window{};
+    bool headless = false;
+    bool contextCreated = true;
+#if defined(XR_TUTORIAL_OPENGL_HEADLESS_EGL)
+    // Used instead of window by headless contexts. eglSurface is only created when EGL_KHR_surfaceless_context is missing.
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    EGLSurface eglSurface = EGL_NO_SURFACE;
+    EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+
+    // Entry points resolved once with GetExtension() after the context is created, rather than on every call.
+    struct ExtensionFunctions {
+        PFNGLGENSAMPLERSPROC glGenSamplers = nullptr;                                                                  // 3.2+
+        PFNGLSAMPLERPARAMETERIPROC glSamplerParameteri = nullptr;                                                      // 3.2+
+        PFNGLSAMPLERPARAMETERFPROC glSamplerParameterf = nullptr;                                                      // 3.2+
+        PFNGLSAMPLERPARAMETERFVPROC glSamplerParameterfv = nullptr;                                                    // 3.2+
+        PFNGLDELETESAMPLERSPROC glDeleteSamplers = nullptr;                                                            // 3.2+
+        PFNGLVALIDATEPROGRAMPROC glValidateProgram = nullptr;                                                          // 2.0+
+        PFNGLDETACHSHADERPROC glDetachShader = nullptr;                                                                // 2.0+
+        PFNGLVIEWPORTINDEXEDFPROC glViewportIndexedf = nullptr;                                                        // 4.1+
+        PFNGLDEPTHRANGEINDEXEDPROC glDepthRangeIndexed = nullptr;                                                      // 4.1+
+        PFNGLSCISSORINDEXEDPROC glScissorIndexed = nullptr;                                                            // 4.1+
+        PFNGLMINSAMPLESHADINGPROC glMinSampleShading = nullptr;                                                        // 4.0+
+        PFNGLSAMPLEMASKIPROC glSampleMaski = nullptr;                                                                  // 3.2+
+        PFNGLDEPTHBOUNDSEXTPROC glDepthBoundsEXT = nullptr;                                                            // EXT
+        PFNGLSTENCILOPSEPARATEPROC glStencilOpSeparate = nullptr;                                                      // 2.0+
+        PFNGLSTENCILFUNCSEPARATEPROC glStencilFuncSeparate = nullptr;                                                  // 2.0+
+        PFNGLSTENCILMASKSEPARATEPROC glStencilMaskSeparate = nullptr;                                                  // 2.0+
+        PFNGLENABLEIPROC glEnablei = nullptr;                                                                          // 3.0+
+        PFNGLDISABLEIPROC glDisablei = nullptr;                                                                        // 3.0+
+        PFNGLBLENDEQUATIONSEPARATEIPROC glBlendEquationSeparatei = nullptr;                                            // 4.0+
+        PFNGLBLENDFUNCSEPARATEIPROC glBlendFuncSeparatei = nullptr;                                                    // 4.0+
+        PFNGLCOLORMASKIPROC glColorMaski = nullptr;                                                                    // 3.0+
+        PFNGLBINDBUFFERRANGEPROC glBindBufferRange = nullptr;                                                          // 3.0+
+        PFNGLBINDSAMPLERPROC glBindSampler = nullptr;                                                                  // 3.0+
+        PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC glDrawElementsInstancedBaseVertexBaseInstance = nullptr;  // 4.2+
+        PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC glDrawArraysInstancedBaseInstance = nullptr;                          // 4.2+
+        PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;                                                              // 4.4+ or ARB_buffer_storage
+        PFNGLMAPBUFFERRANGEPROC glMapBufferRange = nullptr;                                                            // 3.0+
+        PFNGLFENCESYNCPROC glFenceSync = nullptr;                                                                      // 3.2+
+        PFNGLCLIENTWAITSYNCPROC glClientWaitSync = nullptr;                                                            // 3.2+
+        PFNGLDELETESYNCPROC glDeleteSync = nullptr;                                                                    // 3.2+
+        PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = nullptr;                                                        // 4.1+ or ARB_get_program_binary
+        PFNGLPROGRAMBINARYPROC glProgramBinary = nullptr;                                                              // 4.1+ or ARB_get_program_binary
+        PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;                                                      // 4.1+ or ARB_get_program_binary
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR = nullptr;                                  // KHR/ARB_parallel_shader_compile
+        PFNGLQUERYCOUNTERPROC glQueryCounter = nullptr;                                                                // 3.3+ or ARB_timer_query
+        PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v = nullptr;                                                  // 3.3+ or ARB_timer_query
+        PFNGLDRAWELEMENTSINDIRECTPROC glDrawElementsIndirect = nullptr;                                                // 4.0+ or ARB_draw_indirect
+        PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect = nullptr;                                      // 4.3+ or ARB_multi_draw_indirect
+    } ext;
+    bool benchmark = false;
 
     PFN_xrGetOpenGLGraphicsRequirementsKHR xrGetOpenGLGraphicsRequirementsKHR = nullptr;
 #if defined(XR_USE_PLATFORM_WIN32)
@@ -94,13 +238,131 @@ private:
     std::unordered_map<XrSwapchain, std::pair<SwapchainType, std::vector<XrSwapchainImageOpenGLKHR>>> swapchainImagesMap{};
 
     std::unordered_map<GLuint, BufferCreateInfo> buffers{};
+    // STREAM buffers are persistently and coherently mapped when glBufferStorage is available. SetBufferData() writes
+    // straight into them, so callers must keep to the per-submission regions described by GetFramesInFlight().
+    std::unordered_map<GLuint, char*> mappedBuffers{};
     std::unordered_map<GLuint, ImageCreateInfo> images{};
     std::unordered_map<GLuint, ImageViewCreateInfo> imageViews{};
 
+    struct ShaderInfo {
+        GLenum type;
+        std::string source;
+        bool compiled;
+    };
+    std::unordered_map<GLuint, ShaderInfo> shaders{};
+
+    // Linked programs are saved with glGetProgramBinary() and reloaded on the next launch. The file name is a hash of the
+    // driver's vendor, renderer and version strings and of the program's shader sources. XR_TUTORIAL_OPENGL_PROGRAM_CACHE_DIR sets
+    // the directory, which defaults to the working directory.
+    std::string programBinaryDirectory;
+    uint64_t programBinaryDriverHash = HashFNV1a(nullptr, 0);
+    uint32_t programCreationCount = 0;
+    uint32_t programCacheHitCount = 0;
+    double programCreationMs = 0.0;
+
+    // Programs whose link has been issued, but whose status hasn't been checked yet.
+    struct PendingProgram {
+        std::vector<GLuint> shaders;
+        std::string binaryFileName;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::unordered_map<GLuint, PendingProgram> pendingPrograms{};
+
+    // GL_TIMESTAMP queries, rather than GL_TIME_ELAPSED, so that scopes can nest. Each submission records into the next
+    // frame of the ring, and a frame's results are read when the ring comes back round to it. Results that still aren't
+    // available by then are dropped rather than waited for.
+    struct TimestampFrame {
+        std::vector<GLuint> queries;
+        std::vector<TimestampScope> scopes;
+        uint64_t submission = 0;
+    };
+    void ReadTimestampScopes(TimestampFrame& timestampFrame);
+    std::vector<TimestampFrame> timestampFrames = std::vector<TimestampFrame>(4);
+    size_t timestampFrameIndex = 0;
+    std::vector<uint32_t> openTimestampScopes{};  // Indices into the current TimestampFrame's scopes.
+    uint64_t submissionCount = 0;
+
+    // Framebuffers are cached by their attachments and are only validated when created. Entries are removed when one
+    // of their image views or images is destroyed.
+    struct FramebufferKey {
+        std::vector<GLuint> colorViews;
+        GLuint depthStencilView = 0;
+        bool operator==(const FramebufferKey& other) const {
+            return colorViews == other.colorViews && depthStencilView == other.depthStencilView;
+        }
+    };
+    struct FramebufferKeyHash {
+        size_t operator()(const FramebufferKey& key) const;
+    };
+    std::unordered_map<FramebufferKey, GLuint, FramebufferKeyHash> framebufferCache{};
     GLuint setFramebuffer = 0;
+
     std::unordered_map<GLuint, PipelineCreateInfo> pipelines{};
     GLuint setPipeline = 0;
-    GLuint vertexArray = 0;
     GLuint setIndexBuffer = 0;
+
+    // Vertex array objects are cached by pipeline, vertex buffers and index buffer, and are bound when drawing. Entries
+    // are removed when their pipeline or one of their buffers is destroyed.
+    struct VertexArrayKey {
+        GLuint pipeline = 0;
+        std::vector<GLuint> vertexBuffers;
+        GLuint indexBuffer = 0;
+        bool operator==(const VertexArrayKey& other) const {
+            return pipeline == other.pipeline && vertexBuffers == other.vertexBuffers && indexBuffer == other.indexBuffer;
+        }
+    };
+    struct VertexArrayKeyHash {
+        size_t operator()(const VertexArrayKey& key) const;
+    };
+    std::unordered_map<VertexArrayKey, GLuint, VertexArrayKeyHash> vertexArrayCache{};
+    VertexArrayKey setVertexArrayKey{};
+    GLuint boundVertexArray = 0;
+
+    // The state last applied by SetPipeline(). A state call is only issued when its value differs. BeginRendering(), or
+    // only EndFrame() with SetKeepShadowStateUntilEndFrame(true), invalidates all of it by bumping shadowGeneration.
+    static constexpr size_t maxShadowedAttachments = 8;
+    struct ShadowState {
+        Shadowed<GLuint> program;
+        std::bitset<(size_t)ShadowedCapability::COUNT> capabilities;
+        std::bitset<(size_t)ShadowedCapability::COUNT> capabilitiesKnown;
+        std::bitset<maxShadowedAttachments> blendEnabled;
+        std::bitset<maxShadowedAttachments> blendEnabledKnown;
+        Shadowed<GLenum> polygonMode;
+        Shadowed<GLenum> cullFace;
+        Shadowed<GLenum> frontFace;
+        Shadowed<std::array<float, 2>> polygonOffset;
+        Shadowed<float> lineWidth;
+        Shadowed<float> minSampleShading;
+        Shadowed<uint32_t> sampleMask;
+        Shadowed<bool> depthMask;
+        Shadowed<GLenum> depthFunc;
+        Shadowed<std::array<float, 2>> depthBounds;
+        Shadowed<std::array<GLenum, 3>> stencilOp[2];
+        Shadowed<std::array<uint32_t, 3>> stencilFunc[2];
+        Shadowed<uint32_t> stencilWriteMask[2];
+        Shadowed<GLenum> logicOp;
+        Shadowed<std::array<GLenum, 2>> blendEquation[maxShadowedAttachments];
+        Shadowed<std::array<GLenum, 4>> blendFunc[maxShadowedAttachments];
+        Shadowed<uint32_t> colorWriteMask[maxShadowedAttachments];
+        Shadowed<std::array<float, 4>> blendColor;
+    } shadowState{};
+    uint32_t shadowGeneration = 1;
+    bool keepShadowStateUntilEndFrame = false;
+    // Accumulated over a frame and reported by EndFrame() in benchmark mode.
+    uint32_t stateCallsIssued = 0;
+    uint32_t stateCallsSkipped = 0;
+    uint32_t pipelinesSkipped = 0;
+    uint64_t renderedFrames = 0;
+
+    // One fence per submission in flight. BeginRendering() waits on the oldest before its regions are rewritten.
+    std::vector<GLsync> frameFences{};
+    size_t frameIndex = 0;
+
+    // One persistently mapped uniform buffer, split into a segment per submission in flight, backs AllocateTransientUniformData().
+    GLuint transientUniformBuffer = 0;
+    char* transientUniformMappedData = nullptr;
+    size_t transientUniformSegmentSize = 1024 * 1024;
+    size_t transientUniformAlignment = 256;
+    size_t transientUniformOffset = 0;
 };
 #endif
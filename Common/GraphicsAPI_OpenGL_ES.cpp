@@ -371,6 +371,8 @@ GraphicsAPI_OpenGL_ES::GraphicsAPI_OpenGL_ES() {
     GLint glMinorVersion = 0;
     glGetIntegerv(GL_MAJOR_VERSION, &glMajorVersion);
     glGetIntegerv(GL_MINOR_VERSION, &glMinorVersion);
+    LoadTimerQueryFunctions();
+    CreateProgramBinaryCache();
 
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -400,6 +402,8 @@ GraphicsAPI_OpenGL_ES::GraphicsAPI_OpenGL_ES(XrInstance m_xrInstance, XrSystemId
     GLint glMinorVersion = 0;
     glGetIntegerv(GL_MAJOR_VERSION, &glMajorVersion);
     glGetIntegerv(GL_MINOR_VERSION, &glMinorVersion);
+    LoadTimerQueryFunctions();
+    CreateProgramBinaryCache();
 
     const XrVersion glApiVersion = XR_MAKE_VERSION(glMajorVersion, glMinorVersion, 0);
     if (graphicsRequirements.minApiVersionSupported > glApiVersion) {
@@ -416,10 +420,34 @@ GraphicsAPI_OpenGL_ES::GraphicsAPI_OpenGL_ES(XrInstance m_xrInstance, XrSystemId
 }
 
 GraphicsAPI_OpenGL_ES::~GraphicsAPI_OpenGL_ES() {
+    for (TimestampFrame &timestampFrame : timestampFrames) {
+        glDeleteQueries(static_cast<GLsizei>(timestampFrame.queries.size()), timestampFrame.queries.data());
+    }
+    DestroyProgramBinaryCache();
     ksGpuWindow_Destroy(&window);
 }
 // XR_DOCS_TAG_END_GraphicsAPI_OpenGL_ES
 
+void GraphicsAPI_OpenGL_ES::LoadTimerQueryFunctions() {
+    // GetExtension() may return an address for any name, so the extension string is checked first.
+    bool supported = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount && !supported; i++) {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        supported = extension && strcmp(extension, "GL_EXT_disjoint_timer_query") == 0;
+    }
+    if (!supported) {
+        return;
+    }
+    ext.glQueryCounterEXT = (PFNGLQUERYCOUNTEREXTPROC)GetExtension("glQueryCounterEXT");
+    ext.glGetQueryObjectui64vEXT = (PFNGLGETQUERYOBJECTUI64VEXTPROC)GetExtension("glGetQueryObjectui64vEXT");
+    if (!ext.glQueryCounterEXT || !ext.glGetQueryObjectui64vEXT) {
+        ext.glQueryCounterEXT = nullptr;
+        ext.glGetQueryObjectui64vEXT = nullptr;
+    }
+}
+
 void *GraphicsAPI_OpenGL_ES::CreateDesktopSwapchain(const SwapchainCreateInfo &swapchainCI) { return nullptr; }
 void GraphicsAPI_OpenGL_ES::DestroyDesktopSwapchain(void *&swapchain) {}
 void *GraphicsAPI_OpenGL_ES::GetDesktopSwapchainImage(void *swapchain, uint32_t index) { return nullptr; }
@@ -568,13 +596,22 @@ void *GraphicsAPI_OpenGL_ES::CreateBuffer(const BufferCreateInfo &bufferCI) {
         target = GL_ELEMENT_ARRAY_BUFFER;
     } else if (bufferCI.type == BufferCreateInfo::Type::UNIFORM) {
         target = GL_UNIFORM_BUFFER;
+    } else if (bufferCI.type == BufferCreateInfo::Type::INDIRECT) {
+        target = GL_DRAW_INDIRECT_BUFFER;
     } else {
         DEBUG_BREAK;
         std::cout << "ERROR: OPENGL: Unknown Buffer Type." << std::endl;
     }
 
+    GLenum usage = GL_DYNAMIC_DRAW;
+    if (bufferCI.usage == BufferCreateInfo::Usage::STATIC) {
+        usage = GL_STATIC_DRAW;
+    } else if (bufferCI.usage == BufferCreateInfo::Usage::STREAM) {
+        usage = GL_STREAM_DRAW;
+    }
+
     glBindBuffer(target, buffer);
-    glBufferData(target, (GLsizeiptr)bufferCI.size, bufferCI.data, GL_STATIC_DRAW);
+    glBufferData(target, (GLsizeiptr)bufferCI.size, bufferCI.data, usage);
     glBindBuffer(target, 0);
 
     buffers[buffer] = bufferCI;
@@ -620,8 +657,20 @@ void *GraphicsAPI_OpenGL_ES::CreateShader(const ShaderCreateInfo &shaderCI) {
     }
     GLuint shader = glCreateShader(type);
 
+    // Compiling is deferred to CreatePipeline(), so that programs loaded from the program binary cache skip it.
     glShaderSource(shader, 1, &shaderCI.sourceData, nullptr);
+    shaders[shader] = {type, std::string(shaderCI.sourceData, shaderCI.sourceSize ? shaderCI.sourceSize : strlen(shaderCI.sourceData)), false};
+
+    return (void *)(uint64_t)shader;
+}
+
+void GraphicsAPI_OpenGL_ES::CompileShader(GLuint shader) {
+    ShaderInfo &shaderInfo = shaders[shader];
+    if (shaderInfo.compiled) {
+        return;
+    }
     glCompileShader(shader);
+    shaderInfo.compiled = true;
 
     GLint isCompiled = 0;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
@@ -633,42 +682,57 @@ void *GraphicsAPI_OpenGL_ES::CreateShader(const ShaderCreateInfo &shaderCI) {
         glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
         std::cout << infoLog.data() << std::endl;
         DEBUG_BREAK;
-
-        glDeleteShader(shader);
-        shader = 0;
     }
-    return (void *)(uint64_t)shader;
 }
 
 void GraphicsAPI_OpenGL_ES::DestroyShader(void *&shader) {
     GLuint glShader = (GLuint)(uint64_t)shader;
+    shaders.erase(glShader);
     glDeleteShader(glShader);
     shader = nullptr;
 }
 
 void *GraphicsAPI_OpenGL_ES::CreatePipeline(const PipelineCreateInfo &pipelineCI) {
-    GLuint program = glCreateProgram();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    for (const void *const &shader : pipelineCI.shaders)
-        glAttachShader(program, (GLuint)(uint64_t)shader);
+    std::string binaryFileName = GetProgramBinaryFileName(pipelineCI);
+    GLuint program = binaryFileName.empty() ? 0 : LoadProgramBinary(binaryFileName);
+    if (program) {
+        programCacheHitCount++;
+    } else {
+        program = glCreateProgram();
 
-    glLinkProgram(program);
-    glValidateProgram(program);
+        for (const void *const &shader : pipelineCI.shaders) {
+            CompileShader((GLuint)(uint64_t)shader);
+            glAttachShader(program, (GLuint)(uint64_t)shader);
+        }
 
-    GLint isLinked = 0;
-    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
-    if (isLinked == GL_FALSE) {
-        GLint maxLength = 0;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+        if (!binaryFileName.empty()) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+        glValidateProgram(program);
 
-        std::vector<GLchar> infoLog(maxLength);
-        glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+        GLint isLinked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+        if (isLinked == GL_FALSE) {
+            GLint maxLength = 0;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
 
-        glDeleteProgram(program);
+            std::vector<GLchar> infoLog(maxLength);
+            glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+
+            glDeleteProgram(program);
+        } else if (!binaryFileName.empty()) {
+            SaveProgramBinary(program, binaryFileName);
+        }
+
+        for (const void *const &shader : pipelineCI.shaders)
+            glDetachShader(program, (GLuint)(uint64_t)shader);
     }
 
-    for (const void *const &shader : pipelineCI.shaders)
-        glDetachShader(program, (GLuint)(uint64_t)shader);
+    programCreationCount++;
+    programCreationMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
     pipelines[program] = pipelineCI;
 
@@ -682,15 +746,116 @@ void GraphicsAPI_OpenGL_ES::DestroyPipeline(void *&pipeline) {
     pipeline = nullptr;
 }
 
+void GraphicsAPI_OpenGL_ES::CreateProgramBinaryCache() {
+    GLint binaryFormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+    if (binaryFormatCount == 0) {
+        return;
+    }
+
+    // There is no writable working directory on Android, so the application must provide one.
+    programBinaryDirectory = GetEnv("XR_TUTORIAL_OPENGL_PROGRAM_CACHE_DIR");
+    if (programBinaryDirectory.empty()) {
+        return;
+    }
+
+    // Binaries are only valid for the driver that produced them, so its identity is part of every key.
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const char *string = (const char *)glGetString(name);
+        if (string) {
+            programBinaryDriverHash = HashFNV1a(string, strlen(string) + 1, programBinaryDriverHash);
+        }
+    }
+}
+
+void GraphicsAPI_OpenGL_ES::DestroyProgramBinaryCache() {
+    std::cout << "OPENGL ES: Created " << programCreationCount << " programs in " << programCreationMs << " ms, "
+              << programCacheHitCount << " from the program binary cache." << std::endl;
+}
+
+std::string GraphicsAPI_OpenGL_ES::GetProgramBinaryFileName(const PipelineCreateInfo &pipelineCI) {
+    if (programBinaryDirectory.empty()) {
+        return "";
+    }
+    uint64_t hash = programBinaryDriverHash;
+    for (const void *const &shader : pipelineCI.shaders) {
+        const ShaderInfo &shaderInfo = shaders[(GLuint)(uint64_t)shader];
+        hash = HashFNV1a(&shaderInfo.type, sizeof(shaderInfo.type), hash);
+        hash = HashFNV1a(shaderInfo.source.data(), shaderInfo.source.size(), hash);
+    }
+
+    std::stringstream fileName;
+    fileName << programBinaryDirectory << "/GLProgramBinary_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return fileName.str();
+}
+
+GLuint GraphicsAPI_OpenGL_ES::LoadProgramBinary(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file || data.size() <= sizeof(GLenum)) {
+        return 0;
+    }
+
+    // The file holds the binary format, followed by the binary itself.
+    GLenum binaryFormat = 0;
+    memcpy(&binaryFormat, data.data(), sizeof(binaryFormat));
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, binaryFormat, data.data() + sizeof(binaryFormat), static_cast<GLsizei>(data.size() - sizeof(binaryFormat)));
+
+    GLint isLinked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if (isLinked == GL_FALSE) {
+        // The driver rejected the binary, e.g. after a driver update. It is rebuilt from source and overwritten.
+        std::cout << "WARNING: OPENGL ES: Ignoring incompatible program binary: " << fileName << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void GraphicsAPI_OpenGL_ES::SaveProgramBinary(GLuint program, const std::string &fileName) {
+    GLint binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0) {
+        return;
+    }
+
+    GLenum binaryFormat = 0;
+    std::vector<char> data(sizeof(binaryFormat) + binaryLength);
+    glGetProgramBinary(program, binaryLength, &binaryLength, &binaryFormat, data.data() + sizeof(binaryFormat));
+    memcpy(data.data(), &binaryFormat, sizeof(binaryFormat));
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), sizeof(binaryFormat) + binaryLength);
+    if (!file) {
+        std::cout << "WARNING: OPENGL ES: Failed to write program binary: " << fileName << std::endl;
+    }
+}
+
 void GraphicsAPI_OpenGL_ES::BeginRendering() {
     glGenVertexArrays(1, &vertexArray);
     glBindVertexArray(vertexArray);
 
     glGenFramebuffers(1, &setFramebuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, setFramebuffer);
+
+    timestampFrameIndex = (timestampFrameIndex + 1) % timestampFrames.size();
+    TimestampFrame &timestampFrame = timestampFrames[timestampFrameIndex];
+    ReadTimestampScopes(timestampFrame);
+    timestampFrame.submission = submissionCount++;
+    openTimestampScopes.clear();
 }
 
 void GraphicsAPI_OpenGL_ES::EndRendering() {
+    while (!openTimestampScopes.empty()) {
+        EndTimestampScope();
+    }
+
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glDeleteFramebuffers(1, &setFramebuffer);
     setFramebuffer = 0;
@@ -725,6 +890,8 @@ void GraphicsAPI_OpenGL_ES::SetBufferData(void *buffer, size_t offset, size_t si
         target = GL_ELEMENT_ARRAY_BUFFER;
     } else if (bufferCI.type == BufferCreateInfo::Type::UNIFORM) {
         target = GL_UNIFORM_BUFFER;
+    } else if (bufferCI.type == BufferCreateInfo::Type::INDIRECT) {
+        target = GL_DRAW_INDIRECT_BUFFER;
     } else {
         DEBUG_BREAK;
         std::cout << "ERROR: OPENGL: Unknown Buffer Type." << std::endl;
@@ -737,6 +904,68 @@ void GraphicsAPI_OpenGL_ES::SetBufferData(void *buffer, size_t offset, size_t si
     }
 }
 
+void GraphicsAPI_OpenGL_ES::BeginTimestampScope(const char *name) {
+    TimestampFrame &timestampFrame = timestampFrames[timestampFrameIndex];
+    uint32_t index = static_cast<uint32_t>(timestampFrame.scopes.size());
+    if (!ext.glQueryCounterEXT || index >= maxTimestampScopes) {
+        openTimestampScopes.push_back(UINT32_MAX);  // Not measured, but still has to be matched by EndTimestampScope().
+        return;
+    }
+    if (timestampFrame.queries.empty()) {
+        timestampFrame.queries.resize(2 * maxTimestampScopes);
+        glGenQueries(static_cast<GLsizei>(timestampFrame.queries.size()), timestampFrame.queries.data());
+    }
+    timestampFrame.scopes.push_back({name, static_cast<uint32_t>(openTimestampScopes.size()), 2 * index, 2 * index + 1});
+    openTimestampScopes.push_back(index);
+    ext.glQueryCounterEXT(timestampFrame.queries[2 * index], GL_TIMESTAMP_EXT);
+}
+
+void GraphicsAPI_OpenGL_ES::EndTimestampScope() {
+    if (openTimestampScopes.empty()) {
+        std::cout << "ERROR: OPENGL ES: EndTimestampScope() called without a matching BeginTimestampScope()." << std::endl;
+        return;
+    }
+    uint32_t index = openTimestampScopes.back();
+    openTimestampScopes.pop_back();
+    if (index != UINT32_MAX) {
+        TimestampFrame &timestampFrame = timestampFrames[timestampFrameIndex];
+        ext.glQueryCounterEXT(timestampFrame.queries[timestampFrame.scopes[index].endQuery], GL_TIMESTAMP_EXT);
+    }
+}
+
+void GraphicsAPI_OpenGL_ES::ReadTimestampScopes(TimestampFrame &timestampFrame) {
+    if (timestampFrame.scopes.empty()) {
+        return;
+    }
+    if (timestampScopeResults.size() > 4096) {
+        timestampScopeResults.clear();  // Nobody is collecting them.
+    }
+    // Reading GL_GPU_DISJOINT_EXT also clears it. When set, the timer was unreliable at some point since the last read,
+    // which may have been while any of these queries were in flight.
+    GLint disjoint = GL_FALSE;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint) {
+        timestampFrame.scopes.clear();
+        return;
+    }
+    for (const TimestampScope &scope : timestampFrame.scopes) {
+        GLuint beginQuery = timestampFrame.queries[scope.beginQuery];
+        GLuint endQuery = timestampFrame.queries[scope.endQuery];
+        GLuint beginAvailable = GL_FALSE;
+        GLuint endAvailable = GL_FALSE;
+        glGetQueryObjectuiv(beginQuery, GL_QUERY_RESULT_AVAILABLE, &beginAvailable);
+        glGetQueryObjectuiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &endAvailable);
+        if (beginAvailable && endAvailable) {
+            GLuint64 beginTime = 0;
+            GLuint64 endTime = 0;
+            ext.glGetQueryObjectui64vEXT(beginQuery, GL_QUERY_RESULT, &beginTime);
+            ext.glGetQueryObjectui64vEXT(endQuery, GL_QUERY_RESULT, &endTime);
+            timestampScopeResults.push_back({scope.name, scope.depth, timestampFrame.submission, double(endTime - beginTime) / 1000000.0});
+        }
+    }
+    timestampFrame.scopes.clear();
+}
+
 void GraphicsAPI_OpenGL_ES::SetRenderAttachments(void **colorViews, size_t colorViewCount, void *depthStencilView, uint32_t width, uint32_t height, void *pipeline) {
     // Reset Framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -1025,6 +1254,7 @@ void GraphicsAPI_OpenGL_ES::SetVertexBuffers(void **vertexBuffers, size_t count)
                         const void *offset = (const void *)vertexAttribute.offset;
                         glEnableVertexAttribArray(attribIndex);
                         glVertexAttribPointer(attribIndex, size, type, false, stride, offset);
+                        glVertexAttribDivisor(attribIndex, vertexBinding.inputRate == VertexInputRate::PER_INSTANCE ? 1 : 0);
                     }
                 }
             }
@@ -1046,6 +1276,23 @@ void GraphicsAPI_OpenGL_ES::DrawIndexed(uint32_t indexCount, uint32_t instanceCo
     glDrawElementsInstanced(ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology),indexCount, indexType, nullptr,instanceCount);
 }
 
+void GraphicsAPI_OpenGL_ES::DrawIndexedIndirect(void *indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    // OpenGL ES 3.1 has no multi-draw indirect, so each command is a separate call. The commands' firstInstance must be 0.
+    if (!glDrawElementsIndirect) {
+        std::cout << "ERROR: OPENGL ES: DrawIndexedIndirect() requires OpenGL ES 3.1." << std::endl;
+        return;
+    }
+    if (!stride) {
+        stride = sizeof(DrawIndexedIndirectCommand);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, (GLuint)(size_t)indirectBuffer);
+    GLenum mode = ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology);
+    GLenum indexType = buffers[setIndexBuffer].stride == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    for (uint32_t i = 0; i < drawCount; i++) {
+        glDrawElementsIndirect(mode, indexType, (const void *)(offset + (size_t)i * stride));
+    }
+}
+
 void GraphicsAPI_OpenGL_ES::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
     glDrawArraysInstanced(ToGLTopology(pipelines[setPipeline].inputAssemblyState.topology), firstVertex, vertexCount, instanceCount);
 }
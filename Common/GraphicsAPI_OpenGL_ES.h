@@ -72,8 +72,20 @@ public:
     virtual void SetIndexBuffer(void* indexBuffer) override;
     virtual void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0) override;
     virtual void Draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0) override;
+    virtual void DrawIndexedIndirect(void* indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride = 0) override;
+
+    virtual void BeginTimestampScope(const char* name) override;
+    virtual void EndTimestampScope() override;
 
 private:
+    void LoadTimerQueryFunctions();
+    void CreateProgramBinaryCache();
+    void DestroyProgramBinaryCache();
+    std::string GetProgramBinaryFileName(const PipelineCreateInfo& pipelineCI);
+    GLuint LoadProgramBinary(const std::string& fileName);
+    void SaveProgramBinary(GLuint program, const std::string& fileName);
+    void CompileShader(GLuint shader);
+
     virtual const std::vector<int64_t> GetSupportedColorSwapchainFormats() override;
     virtual const std::vector<int64_t> GetSupportedDepthSwapchainFormats() override;
 
@@ -89,10 +101,46 @@ private:
     std::unordered_map<GLuint, ImageCreateInfo> images{};
     std::unordered_map<GLuint, ImageViewCreateInfo> imageViews{};
 
+    struct ShaderInfo {
+        GLenum type;
+        std::string source;
+        bool compiled;
+    };
+    std::unordered_map<GLuint, ShaderInfo> shaders{};
+
+    // Linked programs are saved with glGetProgramBinary() and reloaded on the next launch. The file name is a hash of the
+    // driver's vendor, renderer and version strings and of the program's shader sources. The cache is disabled unless
+    // XR_TUTORIAL_OPENGL_PROGRAM_CACHE_DIR names a writable directory.
+    std::string programBinaryDirectory;
+    uint64_t programBinaryDriverHash = HashFNV1a(nullptr, 0);
+    uint32_t programCreationCount = 0;
+    uint32_t programCacheHitCount = 0;
+    double programCreationMs = 0.0;
+
     GLuint setFramebuffer = 0;
     std::unordered_map<GLuint, PipelineCreateInfo> pipelines{};
     GLuint setPipeline = 0;
     GLuint vertexArray = 0;
     GLuint setIndexBuffer = 0;
+
+    // Entry points resolved once with GetExtension() after the context is created. Both are nullptr when
+    // GL_EXT_disjoint_timer_query is missing, and the timestamp scopes are then ignored.
+    struct ExtensionFunctions {
+        PFNGLQUERYCOUNTEREXTPROC glQueryCounterEXT = nullptr;                // EXT_disjoint_timer_query
+        PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT = nullptr;  // EXT_disjoint_timer_query
+    } ext;
+
+    // As GraphicsAPI_OpenGL, with a ring of query sets that are read back a few submissions later. All results read
+    // back while GL_GPU_DISJOINT_EXT is set, such as after a change of GPU frequency, are dropped.
+    struct TimestampFrame {
+        std::vector<GLuint> queries;
+        std::vector<TimestampScope> scopes;
+        uint64_t submission = 0;
+    };
+    void ReadTimestampScopes(TimestampFrame& timestampFrame);
+    std::vector<TimestampFrame> timestampFrames = std::vector<TimestampFrame>(4);
+    size_t timestampFrameIndex = 0;
+    std::vector<uint32_t> openTimestampScopes{};  // Indices into the current TimestampFrame's scopes.
+    uint64_t submissionCount = 0;
 };
 #endif
@@ -24,7 +24,7 @@
 #define VK_MAKE_API_VERSION(variant, major, minor, patch) VK_MAKE_VERSION(major, minor, patch)
 #endif
 
-static bool MemoryTypeFromProperties(VkPhysicalDeviceMemoryProperties memoryProperties, uint32_t typeBits, VkMemoryPropertyFlags requirementsMask, uint32_t *typeIndex) {
+static bool MemoryTypeFromProperties(const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t typeBits, VkMemoryPropertyFlags requirementsMask, uint32_t *typeIndex) {
     // Search memory types to find first index with those properties
     for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
         if ((typeBits & 1) == 1) {
@@ -75,7 +75,11 @@ VkDescriptorType ToVkDescrtiptorType(const GraphicsAPI::DescriptorInfo &descInfo
     switch (descInfo.type) {
     default:
     case GraphicsAPI::DescriptorInfo::Type::BUFFER: {
-        vkType = descInfo.readWrite ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        if (descInfo.dynamicOffset) {
+            vkType = descInfo.readWrite ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        } else {
+            vkType = descInfo.readWrite ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
         break;
     }
     case GraphicsAPI::DescriptorInfo::Type::IMAGE: {
@@ -90,7 +94,7 @@ VkDescriptorType ToVkDescrtiptorType(const GraphicsAPI::DescriptorInfo &descInfo
     return vkType;
 }
 
-GraphicsAPI_Vulkan::GraphicsAPI_Vulkan() {
+GraphicsAPI_Vulkan::GraphicsAPI_Vulkan(uint32_t framesInFlight) {
     // Instance
     VkApplicationInfo ai;
     ai.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -193,6 +197,7 @@ GraphicsAPI_Vulkan::GraphicsAPI_Vulkan() {
 
     VkPhysicalDeviceFeatures features;
     vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
 
     VkDeviceCreateInfo deviceCI;
     deviceCI.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -214,42 +219,16 @@ GraphicsAPI_Vulkan::GraphicsAPI_Vulkan() {
     cmdPoolCI.queueFamilyIndex = queueFamilyIndex;
     VULKAN_CHECK(vkCreateCommandPool(device, &cmdPoolCI, nullptr, &cmdPool), "Failed to create CommandPool.");
 
-    VkCommandBufferAllocateInfo allocateInfo;
-    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocateInfo.pNext = nullptr;
-    allocateInfo.commandPool = cmdPool;
-    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocateInfo.commandBufferCount = 1;
-    VULKAN_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &cmdBuffer), "Failed to allocate CommandBuffers.");
-
     vkGetDeviceQueue(device, queueFamilyIndex, queueIndex, &queue);
 
-    VkFenceCreateInfo fenceCI{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-    fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceCI.pNext = nullptr;
-    fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    VULKAN_CHECK(vkCreateFence(device, &fenceCI, nullptr, &fence), "Failed to create Fence.")
-
-    uint32_t maxSets = 1024;
-    std::vector<VkDescriptorPoolSize> poolSizes{
-        {VK_DESCRIPTOR_TYPE_SAMPLER, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16 * maxSets}};
-
-    VkDescriptorPoolCreateInfo descPoolCI;
-    descPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descPoolCI.pNext = nullptr;
-    descPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    descPoolCI.maxSets = maxSets;
-    descPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    descPoolCI.pPoolSizes = poolSizes.data();
-    VULKAN_CHECK(vkCreateDescriptorPool(device, &descPoolCI, nullptr, &descriptorPool), "Failed to create DescriptorPool");
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    CreateFrameContexts(framesInFlight);
+    CreateUploadResources();
+    CreatePipelineCache();
 }
 
 // XR_DOCS_TAG_BEGIN_GraphicsAPI_Vulkan
-GraphicsAPI_Vulkan::GraphicsAPI_Vulkan(XrInstance m_xrInstance, XrSystemId systemId) {
+GraphicsAPI_Vulkan::GraphicsAPI_Vulkan(XrInstance m_xrInstance, XrSystemId systemId, uint32_t framesInFlight) {
     // Instance
     LoadPFN_XrFunctions(m_xrInstance);
 
@@ -358,6 +337,7 @@ GraphicsAPI_Vulkan::GraphicsAPI_Vulkan(XrInstance m_xrInstance, XrSystemId syste
 
     VkPhysicalDeviceFeatures features;
     vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
 
     VkDeviceCreateInfo deviceCI;
     deviceCI.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -379,52 +359,505 @@ GraphicsAPI_Vulkan::GraphicsAPI_Vulkan(XrInstance m_xrInstance, XrSystemId syste
     cmdPoolCI.queueFamilyIndex = queueFamilyIndex;
     VULKAN_CHECK(vkCreateCommandPool(device, &cmdPoolCI, nullptr, &cmdPool), "Failed to create CommandPool.");
 
+    vkGetDeviceQueue(device, queueFamilyIndex, queueIndex, &queue);
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    CreateFrameContexts(framesInFlight);
+    CreateUploadResources();
+    CreatePipelineCache();
+}
+
+GraphicsAPI_Vulkan::~GraphicsAPI_Vulkan() {
+    DestroyFrameContexts();
+    DestroyUploadResources();
+    DestroyPipelineCache();
+    for (const auto &framebuffer : framebufferCache) {
+        vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+    }
+    framebufferCache.clear();
+    vkDestroyCommandPool(device, cmdPool, nullptr);
+    DestroyMemoryPools();
+
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+}
+// XR_DOCS_TAG_END_GraphicsAPI_Vulkan
+
+void GraphicsAPI_Vulkan::CreateFrameContexts(uint32_t framesInFlight) {
+    std::string framesInFlightEnv = GetEnv("XR_TUTORIAL_VULKAN_FRAMES_IN_FLIGHT");
+    if (!framesInFlightEnv.empty()) {
+        framesInFlight = static_cast<uint32_t>(std::strtoul(framesInFlightEnv.c_str(), nullptr, 10));
+    }
+    framesInFlight = std::max(framesInFlight, 1u);
+    frameStallReport = GetEnv("XR_TUTORIAL_VULKAN_BENCHMARK") == "1";
+
+    frameContexts.resize(framesInFlight);
+    for (FrameContext &frameContext : frameContexts) {
+        VkCommandBufferAllocateInfo allocateInfo;
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.pNext = nullptr;
+        allocateInfo.commandPool = cmdPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        VULKAN_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &frameContext.cmdBuffer), "Failed to allocate CommandBuffers.");
+
+        // Created signaled, so that the first wait on each FrameContext returns immediately.
+        VkFenceCreateInfo fenceCI{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceCI.pNext = nullptr;
+        fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VULKAN_CHECK(vkCreateFence(device, &fenceCI, nullptr, &frameContext.fence), "Failed to create Fence.")
+
+        uint32_t maxSets = 1024;
+        std::vector<VkDescriptorPoolSize> poolSizes{
+            {VK_DESCRIPTOR_TYPE_SAMPLER, 16 * maxSets},
+            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 16 * maxSets},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 16 * maxSets},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16 * maxSets},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16 * maxSets},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 8 * maxSets},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4 * maxSets}};
+
+        VkDescriptorPoolCreateInfo descPoolCI;
+        descPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descPoolCI.pNext = nullptr;
+        descPoolCI.flags = 0;
+        descPoolCI.maxSets = maxSets;
+        descPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descPoolCI.pPoolSizes = poolSizes.data();
+        VULKAN_CHECK(vkCreateDescriptorPool(device, &descPoolCI, nullptr, &frameContext.descriptorPool), "Failed to create DescriptorPool");
+    }
+    frameContextIndex = frameContexts.size() - 1;
+    cmdBuffer = frameContexts[frameContextIndex].cmdBuffer;
+    frameStallPeriodStart = std::chrono::steady_clock::now();
+
+    VkPhysicalDeviceProperties physicalDeviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+    transientUniformAlignment = static_cast<size_t>(physicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
+
+    // Timestamps are only usable if the graphics queue writes them.
+    uint32_t queueFamilyPropertiesCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertiesCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyPropertiesCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertiesCount, queueFamilyProperties.data());
+    uint32_t timestampValidBits = queueFamilyIndex < queueFamilyPropertiesCount ? queueFamilyProperties[queueFamilyIndex].timestampValidBits : 0;
+    timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+    timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+    if (timestampValidBits > 0 && timestampPeriod > 0.0f) {
+        for (FrameContext &frameContext : frameContexts) {
+            VkQueryPoolCreateInfo queryPoolCI{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+            queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolCI.queryCount = 2 * maxTimestampScopes;
+            VULKAN_CHECK(vkCreateQueryPool(device, &queryPoolCI, nullptr, &frameContext.timestampQueryPool), "Failed to create QueryPool.");
+        }
+    }
+    transientUniformBuffer = (VkBuffer)CreateBuffer({BufferCreateInfo::Type::UNIFORM, 0, transientUniformSegmentSize * frameContexts.size(), nullptr, BufferCreateInfo::Usage::STREAM});
+    transientUniformMappedData = (char *)bufferResources[transientUniformBuffer].first.mappedData;
+}
+
+void GraphicsAPI_Vulkan::DestroyFrameContexts() {
+    void *buffer = (void *)transientUniformBuffer;
+    DestroyBuffer(buffer);
+    transientUniformBuffer = VK_NULL_HANDLE;
+    transientUniformMappedData = nullptr;
+
+    WaitForFrameContexts();
+    for (FrameContext &frameContext : frameContexts) {
+        vkDestroyQueryPool(device, frameContext.timestampQueryPool, nullptr);
+        vkDestroyDescriptorPool(device, frameContext.descriptorPool, nullptr);
+        vkDestroyFence(device, frameContext.fence, nullptr);
+        vkFreeCommandBuffers(device, cmdPool, 1, &frameContext.cmdBuffer);
+    }
+    frameContexts.clear();
+    cmdBuffer = VK_NULL_HANDLE;
+}
+
+void GraphicsAPI_Vulkan::WaitForFrameContexts() {
+    // Resources may still be referenced by any submission in flight, so wait for all of them before destroying anything.
+    std::vector<VkFence> fences;
+    for (const FrameContext &frameContext : frameContexts) {
+        fences.push_back(frameContext.fence);
+    }
+    if (uploadFence) {
+        FlushUploads();
+        fences.push_back(uploadFence);
+    }
+    if (!fences.empty()) {
+        VULKAN_CHECK(vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), true, UINT64_MAX), "Failed to wait for Fences");
+    }
+}
+
+void GraphicsAPI_Vulkan::CreateUploadResources() {
     VkCommandBufferAllocateInfo allocateInfo;
     allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocateInfo.pNext = nullptr;
     allocateInfo.commandPool = cmdPool;
     allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocateInfo.commandBufferCount = 1;
-    VULKAN_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &cmdBuffer), "Failed to allocate CommandBuffers.");
-
-    vkGetDeviceQueue(device, queueFamilyIndex, queueIndex, &queue);
+    VULKAN_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &uploadCmdBuffer), "Failed to allocate CommandBuffers.");
 
-    VkFenceCreateInfo fenceCI{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VkFenceCreateInfo fenceCI;
     fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCI.pNext = nullptr;
     fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    VULKAN_CHECK(vkCreateFence(device, &fenceCI, nullptr, &fence), "Failed to create Fence.")
-
-    uint32_t maxSets = 1024;
-    std::vector<VkDescriptorPoolSize> poolSizes{
-        {VK_DESCRIPTOR_TYPE_SAMPLER, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16 * maxSets},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16 * maxSets}};
-
-    VkDescriptorPoolCreateInfo descPoolCI;
-    descPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descPoolCI.pNext = nullptr;
-    descPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    descPoolCI.maxSets = maxSets;
-    descPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    descPoolCI.pPoolSizes = poolSizes.data();
-    VULKAN_CHECK(vkCreateDescriptorPool(device, &descPoolCI, nullptr, &descriptorPool), "Failed to create DescriptorPool");
+    VULKAN_CHECK(vkCreateFence(device, &fenceCI, nullptr, &uploadFence), "Failed to create Fence.")
+
+    VkBufferCreateInfo vkBufferCI;
+    vkBufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    vkBufferCI.pNext = nullptr;
+    vkBufferCI.flags = 0;
+    vkBufferCI.size = stagingBufferSize;
+    vkBufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    vkBufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vkBufferCI.queueFamilyIndexCount = 0;
+    vkBufferCI.pQueueFamilyIndices = nullptr;
+    VULKAN_CHECK(vkCreateBuffer(device, &vkBufferCI, nullptr, &stagingBuffer), "Failed to create Staging Buffer.");
+
+    VkMemoryRequirements memoryRequirements{};
+    vkGetBufferMemoryRequirements(device, stagingBuffer, &memoryRequirements);
+    stagingAllocation = AllocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    VULKAN_CHECK(vkBindBufferMemory(device, stagingBuffer, stagingAllocation.memory, stagingAllocation.offset), "Failed to bind Memory to Buffer.");
 }
 
-GraphicsAPI_Vulkan::~GraphicsAPI_Vulkan() {
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+void GraphicsAPI_Vulkan::DestroyUploadResources() {
+    WaitForFrameContexts();
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    FreeMemory(stagingAllocation);
+    vkDestroyFence(device, uploadFence, nullptr);
+    vkFreeCommandBuffers(device, cmdPool, 1, &uploadCmdBuffer);
+    stagingBuffer = VK_NULL_HANDLE;
+    stagingAllocation = {};
+    uploadFence = VK_NULL_HANDLE;
+    uploadCmdBuffer = VK_NULL_HANDLE;
+}
 
-    vkDestroyFence(device, fence, nullptr);
+void GraphicsAPI_Vulkan::CreatePipelineCache() {
+    VkPhysicalDeviceProperties physicalDeviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 
-    vkFreeCommandBuffers(device, cmdPool, 1, &cmdBuffer);
-    vkDestroyCommandPool(device, cmdPool, nullptr);
+#if !defined(__ANDROID__)
+    std::string directory = GetEnv("XR_TUTORIAL_VULKAN_PIPELINE_CACHE_DIR");
+    std::stringstream fileName;
+    fileName << (directory.empty() ? "." : directory) << "/VkPipelineCache_";
+    for (const uint8_t &byte : physicalDeviceProperties.pipelineCacheUUID) {
+        fileName << std::hex << std::setw(2) << std::setfill('0') << (uint32_t)byte;
+    }
+    fileName << "_" << std::hex << physicalDeviceProperties.driverVersion << ".bin";
+    pipelineCacheFileName = fileName.str();
+#endif
 
-    vkDestroyDevice(device, nullptr);
-    vkDestroyInstance(instance, nullptr);
+    std::vector<char> cacheData;
+    if (!pipelineCacheFileName.empty()) {
+        std::ifstream file(pipelineCacheFileName, std::ios::binary | std::ios::ate);
+        if (file.is_open()) {
+            cacheData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(cacheData.data(), cacheData.size());
+            if (!file) {
+                cacheData.clear();
+            }
+        }
+    }
+
+    // Only hand the data to the driver if its header matches this device. The version one header is: headerSize,
+    // headerVersion, vendorID and deviceID as uint32_t, followed by the pipelineCacheUUID.
+    if (!cacheData.empty()) {
+        const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+        bool valid = cacheData.size() >= headerSize;
+        if (valid) {
+            uint32_t header[4];
+            memcpy(header, cacheData.data(), sizeof(header));
+            valid = header[0] >= headerSize && header[0] <= cacheData.size()
+                    && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                    && header[2] == physicalDeviceProperties.vendorID
+                    && header[3] == physicalDeviceProperties.deviceID
+                    && memcmp(cacheData.data() + sizeof(header), physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!valid) {
+            std::cout << "WARNING: VULKAN: Ignoring incompatible pipeline cache: " << pipelineCacheFileName << std::endl;
+            cacheData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCI;
+    pipelineCacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCI.pNext = nullptr;
+    pipelineCacheCI.flags = 0;
+    pipelineCacheCI.initialDataSize = cacheData.size();
+    pipelineCacheCI.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+    if (vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache) != VK_SUCCESS && !cacheData.empty()) {
+        // The driver rejected the data, so start again with an empty cache.
+        cacheData.clear();
+        pipelineCacheCI.initialDataSize = 0;
+        pipelineCacheCI.pInitialData = nullptr;
+        VULKAN_CHECK(vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache), "Failed to create PipelineCache.");
+    }
+    pipelineCacheWarm = !cacheData.empty();
+}
+
+void GraphicsAPI_Vulkan::DestroyPipelineCache() {
+    std::cout << "VULKAN: Created " << pipelineCreationCount << " pipelines in " << pipelineCreationMs << " ms"
+              << " with a " << (pipelineCacheWarm ? "warm" : "cold") << " pipeline cache." << std::endl;
+
+    if (!pipelineCacheFileName.empty() && pipelineCache) {
+        size_t dataSize = 0;
+        VULKAN_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr), "Failed to get PipelineCache data size.");
+        std::vector<char> cacheData(dataSize);
+        if (dataSize > 0 && vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()) == VK_SUCCESS) {
+            std::ofstream file(pipelineCacheFileName, std::ios::binary | std::ios::trunc);
+            file.write(cacheData.data(), dataSize);
+            if (!file) {
+                std::cout << "WARNING: VULKAN: Failed to write pipeline cache: " << pipelineCacheFileName << std::endl;
+            }
+        }
+    }
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+}
+
+void GraphicsAPI_Vulkan::UploadBufferData(VkBuffer buffer, size_t offset, size_t size, const void *data) {
+    const char *srcData = (const char *)data;
+    while (size > 0) {
+        if (!uploadRecording) {
+            // The staging buffer is reused once the previous batch has been consumed by the GPU.
+            VULKAN_CHECK(vkWaitForFences(device, 1, &uploadFence, true, UINT64_MAX), "Failed to wait for Fence");
+            VULKAN_CHECK(vkResetFences(device, 1, &uploadFence), "Failed to reset Fence.")
+            stagingOffset = 0;
+
+            VkCommandBufferBeginInfo beginInfo;
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.pNext = nullptr;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            beginInfo.pInheritanceInfo = nullptr;
+            VULKAN_CHECK(vkBeginCommandBuffer(uploadCmdBuffer, &beginInfo), "Failed to begin CommandBuffer.");
+
+            // Earlier submissions may still be reading the buffers that are about to be overwritten.
+            vkCmdPipelineBarrier(uploadCmdBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VkDependencyFlags(0),
+                                 0, nullptr, 0, nullptr, 0, nullptr);
+            uploadRecording = true;
+        }
+
+        // Uploads larger than the staging buffer are split over several batches.
+        VkDeviceSize chunkSize = std::min<VkDeviceSize>(size, stagingBufferSize - stagingOffset);
+        if (chunkSize == 0) {
+            FlushUploads();
+            continue;
+        }
+        memcpy((char *)stagingAllocation.mappedData + stagingOffset, srcData, chunkSize);
+        VkBufferCopy region = {stagingOffset, static_cast<VkDeviceSize>(offset), chunkSize};
+        vkCmdCopyBuffer(uploadCmdBuffer, stagingBuffer, buffer, 1, &region);
+
+        stagingOffset += chunkSize;
+        offset += chunkSize;
+        srcData += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+void GraphicsAPI_Vulkan::FlushUploads() {
+    if (!uploadRecording) {
+        return;
+    }
+
+    // Make the copies visible to every later submission on the queue.
+    VkMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+    vkCmdPipelineBarrier(uploadCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VkDependencyFlags(0),
+                         1, &barrier, 0, nullptr, 0, nullptr);
+    VULKAN_CHECK(vkEndCommandBuffer(uploadCmdBuffer), "Failed to end CommandBuffer.");
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = nullptr;
+    submitInfo.pWaitDstStageMask = nullptr;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &uploadCmdBuffer;
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = nullptr;
+    VULKAN_CHECK(vkQueueSubmit(queue, 1, &submitInfo, uploadFence), "Failed to submit to Queue.");
+    uploadRecording = false;
+}
+
+void GraphicsAPI_Vulkan::ReportFrameStall(double stallMs) {
+    frameStallTotalMs += stallMs;
+    frameStallSubmissions++;
+
+    const uint32_t reportInterval = 500;
+    if (frameStallSubmissions < reportInterval) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double periodMs = std::chrono::duration<double, std::milli>(now - frameStallPeriodStart).count();
+    std::cout << "VULKAN: Frames in flight: " << frameContexts.size()
+              << " | CPU stalled on frame fences: " << frameStallTotalMs / frameStallSubmissions << " ms per submission"
+              << " (" << (periodMs > 0.0 ? 100.0 * frameStallTotalMs / periodMs : 0.0) << "% of CPU time)"
+              << " over " << frameStallSubmissions << " submissions." << std::endl;
+
+    LogMemoryStats();
+
+    frameStallTotalMs = 0.0;
+    frameStallSubmissions = 0;
+    frameStallPeriodStart = now;
+}
+
+GraphicsAPI_Vulkan::MemoryAllocation GraphicsAPI_Vulkan::AllocateMemory(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags properties, bool linear) {
+    MemoryAllocation allocation{};
+    uint32_t memoryTypeIndex = 0;
+    if (!MemoryTypeFromProperties(memoryProperties, memoryRequirements.memoryTypeBits, properties, &memoryTypeIndex)) {
+        std::cout << "ERROR: VULKAN: No memory type supports the requested properties." << std::endl;
+        return allocation;
+    }
+    allocation.poolKey = (memoryTypeIndex << 1) | (linear ? 1 : 0);
+    allocation.size = memoryRequirements.size;
+    std::vector<MemoryBlock> &blocks = memoryPools[allocation.poolKey];
+
+    // First fit: take the first free range that can hold the allocation once its offset is aligned.
+    auto suballocate = [&](MemoryBlock &block) -> bool {
+        for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); it++) {
+            VkDeviceSize rangeOffset = it->first;
+            VkDeviceSize rangeEnd = it->first + it->second;
+            VkDeviceSize offset = Align<VkDeviceSize>(rangeOffset, memoryRequirements.alignment);
+            if (offset + memoryRequirements.size > rangeEnd) {
+                continue;
+            }
+            block.freeRanges.erase(it);
+            if (offset > rangeOffset) {
+                block.freeRanges[rangeOffset] = offset - rangeOffset;
+            }
+            if (offset + memoryRequirements.size < rangeEnd) {
+                block.freeRanges[offset + memoryRequirements.size] = rangeEnd - (offset + memoryRequirements.size);
+            }
+            block.usedBytes += memoryRequirements.size;
+            block.allocationCount++;
+            allocation.memory = block.memory;
+            allocation.offset = offset;
+            allocation.mappedData = block.mappedData ? (char *)block.mappedData + offset : nullptr;
+            return true;
+        }
+        return false;
+    };
+    for (MemoryBlock &block : blocks) {
+        if (block.size - block.usedBytes >= memoryRequirements.size && suballocate(block)) {
+            return allocation;
+        }
+    }
+
+    // No block has room. Resources larger than half a block get a block of their own.
+    const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    VkDeviceSize blockSize = std::min(memoryBlockSize, heapSize / 8);
+    if (memoryRequirements.size > blockSize / 2) {
+        blockSize = memoryRequirements.size;
+    }
+
+    MemoryBlock block;
+    block.size = blockSize;
+    VkMemoryAllocateInfo allocateInfo;
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.pNext = nullptr;
+    allocateInfo.allocationSize = blockSize;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+    VULKAN_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &block.memory), "Failed to allocate Memory.");
+    if (block.memory == VK_NULL_HANDLE) {
+        return allocation;
+    }
+    if (BitwiseCheck<VkMemoryPropertyFlags>(memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        VULKAN_CHECK(vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mappedData), "Can not map Memory.");
+    }
+    block.freeRanges[0] = blockSize;
+    blocks.push_back(block);
+    suballocate(blocks.back());
+    return allocation;
+}
+
+void GraphicsAPI_Vulkan::FreeMemory(const MemoryAllocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    std::vector<MemoryBlock> &blocks = memoryPools[allocation.poolKey];
+    auto blockIt = std::find_if(blocks.begin(), blocks.end(), [&](const MemoryBlock &block) { return block.memory == allocation.memory; });
+    if (blockIt == blocks.end()) {
+        std::cout << "ERROR: VULKAN: Freeing Memory that was not allocated from a pool." << std::endl;
+        return;
+    }
+    MemoryBlock &block = *blockIt;
+    block.usedBytes -= allocation.size;
+    block.allocationCount--;
+
+    // Return the range and merge it with its neighbours.
+    auto it = block.freeRanges.emplace(allocation.offset, allocation.size).first;
+    auto next = std::next(it);
+    if (next != block.freeRanges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        block.freeRanges.erase(next);
+    }
+    if (it != block.freeRanges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            block.freeRanges.erase(it);
+        }
+    }
+
+    // Keep one empty block per pool around for reuse, release any others.
+    if (block.allocationCount == 0 && blocks.size() > 1) {
+        if (block.mappedData) {
+            vkUnmapMemory(device, block.memory);
+        }
+        vkFreeMemory(device, block.memory, nullptr);
+        blocks.erase(blockIt);
+    }
+}
+
+void GraphicsAPI_Vulkan::DestroyMemoryPools() {
+    if (frameStallReport) {
+        LogMemoryStats();
+    }
+    for (auto &pool : memoryPools) {
+        for (MemoryBlock &block : pool.second) {
+            if (block.allocationCount > 0) {
+                std::cout << "WARNING: VULKAN: " << block.allocationCount << " allocations were not freed from memory type " << (pool.first >> 1) << "." << std::endl;
+            }
+            if (block.mappedData) {
+                vkUnmapMemory(device, block.memory);
+            }
+            vkFreeMemory(device, block.memory, nullptr);
+        }
+    }
+    memoryPools.clear();
+}
+
+void GraphicsAPI_Vulkan::LogMemoryStats() {
+    // Fragmentation is the share of free memory that lies outside the largest free range of its block.
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFreeBytes = 0;
+    size_t blockCount = 0;
+    size_t allocationCount = 0;
+    for (const auto &pool : memoryPools) {
+        for (const MemoryBlock &block : pool.second) {
+            reservedBytes += block.size;
+            usedBytes += block.usedBytes;
+            blockCount++;
+            allocationCount += block.allocationCount;
+            VkDeviceSize largestFreeRange = 0;
+            for (const auto &freeRange : block.freeRanges) {
+                freeBytes += freeRange.second;
+                largestFreeRange = std::max(largestFreeRange, freeRange.second);
+            }
+            largestFreeBytes += largestFreeRange;
+        }
+    }
+    std::cout << "VULKAN: Device memory: " << allocationCount << " allocations in " << blockCount << " blocks"
+              << " | " << usedBytes << " of " << reservedBytes << " bytes used"
+              << " | fragmentation: " << (freeBytes > 0 ? 100.0 * (freeBytes - largestFreeBytes) / freeBytes : 0.0) << "%." << std::endl;
 }
-// XR_DOCS_TAG_END_GraphicsAPI_Vulkan
 
 void *GraphicsAPI_Vulkan::CreateDesktopSwapchain(const SwapchainCreateInfo &swapchainCI) {
     VkSurfaceKHR surface{};
@@ -601,30 +1034,20 @@ void *GraphicsAPI_Vulkan::CreateImage(const ImageCreateInfo &imageCI) {
     VkMemoryRequirements memoryRequirements{};
     vkGetImageMemoryRequirements(device, image, &memoryRequirements);
 
-    VkDeviceMemory memory{};
-    VkMemoryAllocateInfo allocateInfo;
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext = nullptr;
-    allocateInfo.allocationSize = memoryRequirements.size;
-
-    VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties{};
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &physicalDeviceMemoryProperties);
-    MemoryTypeFromProperties(physicalDeviceMemoryProperties, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocateInfo.memoryTypeIndex);
+    MemoryAllocation allocation = AllocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    VULKAN_CHECK(vkBindImageMemory(device, image, allocation.memory, allocation.offset), "Failed to bind Memory to Image.");
 
-    VULKAN_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &memory), "Failed to allocate Memory.");
-    VULKAN_CHECK(vkBindImageMemory(device, image, memory, 0), "Failed to bind Memory to Image.");
-
-    imageResources[image] = {memory, imageCI};
+    imageResources[image] = {allocation, imageCI};
     imageStates[image] = vkImageCI.initialLayout;
 
     return (void *)image;
 }
 
 void GraphicsAPI_Vulkan::DestroyImage(void *&image) {
+    WaitForFrameContexts();
     VkImage vkImage = (VkImage)image;
-    VkDeviceMemory memory = imageResources[vkImage].first;
-    vkFreeMemory(device, memory, nullptr);
     vkDestroyImage(device, vkImage, nullptr);
+    FreeMemory(imageResources[vkImage].first);
     imageResources.erase(vkImage);
     imageStates.erase(vkImage);
     image = nullptr;
@@ -652,7 +1075,18 @@ void *GraphicsAPI_Vulkan::CreateImageView(const ImageViewCreateInfo &imageViewCI
 }
 
 void GraphicsAPI_Vulkan::DestroyImageView(void *&imageView) {
+    WaitForFrameContexts();
+    ClearDescriptorSetCaches();
     VkImageView vkImageView = (VkImageView)imageView;
+    for (auto it = framebufferCache.begin(); it != framebufferCache.end();) {
+        const std::vector<VkImageView> &imageViews = it->first.imageViews;
+        if (std::find(imageViews.begin(), imageViews.end(), vkImageView) != imageViews.end()) {
+            vkDestroyFramebuffer(device, it->second, nullptr);
+            it = framebufferCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
     vkDestroyImageView(device, vkImageView, nullptr);
     imageViewResources.erase(vkImageView);
     imageView = nullptr;
@@ -688,6 +1122,8 @@ void *GraphicsAPI_Vulkan::CreateSampler(const SamplerCreateInfo &samplerCI) {
 }
 
 void GraphicsAPI_Vulkan::DestroySampler(void *&sampler) {
+    WaitForFrameContexts();
+    ClearDescriptorSetCaches();
     vkDestroySampler(device, (VkSampler)sampler, nullptr);
     sampler = nullptr;
 }
@@ -699,7 +1135,7 @@ void *GraphicsAPI_Vulkan::CreateBuffer(const BufferCreateInfo &bufferCI) {
     vkBufferCI.pNext = nullptr;
     vkBufferCI.flags = 0;
     vkBufferCI.size = static_cast<VkDeviceSize>(bufferCI.size);
-    vkBufferCI.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | (bufferCI.type == BufferCreateInfo::Type::VERTEX ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT : 0) | (bufferCI.type == BufferCreateInfo::Type::INDEX ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT : 0) | (bufferCI.type == BufferCreateInfo::Type::UNIFORM ? VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT : 0);
+    vkBufferCI.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | (bufferCI.type == BufferCreateInfo::Type::VERTEX ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT : 0) | (bufferCI.type == BufferCreateInfo::Type::INDEX ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT : 0) | (bufferCI.type == BufferCreateInfo::Type::UNIFORM ? VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT : 0) | (bufferCI.type == BufferCreateInfo::Type::INDIRECT ? VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT : 0);
     vkBufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     vkBufferCI.queueFamilyIndexCount = 0;
     vkBufferCI.pQueueFamilyIndices = nullptr;
@@ -708,30 +1144,36 @@ void *GraphicsAPI_Vulkan::CreateBuffer(const BufferCreateInfo &bufferCI) {
     VkMemoryRequirements memoryRequirements{};
     vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
 
-    VkDeviceMemory memory{};
-    VkMemoryAllocateInfo allocateInfo;
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext = nullptr;
-    allocateInfo.allocationSize = memoryRequirements.size;
-
-    VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties{};
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &physicalDeviceMemoryProperties);
-    MemoryTypeFromProperties(physicalDeviceMemoryProperties, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &allocateInfo.memoryTypeIndex);
+    // DYNAMIC and STREAM buffers use host coherent memory whose block stays mapped, so SetBufferData() is just a memcpy.
+    // STREAM buffers prefer memory that is also device local, where the device exposes it.
+    const VkMemoryPropertyFlags hostCoherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkMemoryPropertyFlags properties = hostCoherent;
+    uint32_t memoryTypeIndex = 0;
+    if (bufferCI.usage == BufferCreateInfo::Usage::STATIC) {
+        properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    } else if (bufferCI.usage == BufferCreateInfo::Usage::STREAM && MemoryTypeFromProperties(memoryProperties, memoryRequirements.memoryTypeBits, hostCoherent | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex)) {
+        properties = hostCoherent | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+    MemoryAllocation allocation = AllocateMemory(memoryRequirements, properties, true);
+    VULKAN_CHECK(vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset), "Failed to bind Memory to Buffer.");
 
-    VULKAN_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &memory), "Failed to allocate Memory.");
-    VULKAN_CHECK(vkBindBufferMemory(device, buffer, memory, 0), "Failed to bind Memory to Buffer.");
+    // Device local memory that is also host coherent (e.g. on integrated GPUs) is written directly, otherwise it's staged.
+    if (allocation.mappedData && !BitwiseCheck<VkMemoryPropertyFlags>(memoryProperties.memoryTypes[allocation.poolKey >> 1].propertyFlags, hostCoherent)) {
+        allocation.mappedData = nullptr;
+    }
 
-    bufferResources[buffer] = {memory, bufferCI};
+    bufferResources[buffer] = {allocation, bufferCI};
     SetBufferData((void *)buffer, 0, bufferCI.size, bufferCI.data);
 
     return (void *)buffer;
 }
 
 void GraphicsAPI_Vulkan::DestroyBuffer(void *&buffer) {
+    WaitForFrameContexts();
+    ClearDescriptorSetCaches();
     VkBuffer vkBuffer = (VkBuffer)buffer;
-    VkDeviceMemory memory = bufferResources[vkBuffer].first;
-    vkFreeMemory(device, memory, nullptr);
     vkDestroyBuffer(device, vkBuffer, nullptr);
+    FreeMemory(bufferResources[vkBuffer].first);
     bufferResources.erase(vkBuffer);
     buffer = nullptr;
 }
@@ -879,7 +1321,7 @@ void *GraphicsAPI_Vulkan::CreatePipeline(const PipelineCreateInfo &pipelineCI) {
     std::vector<VkVertexInputBindingDescription> vkVertexInputBindingDescriptions;
     vkVertexInputBindingDescriptions.reserve(pipelineCI.vertexInputState.bindings.size());
     for (auto &binding : pipelineCI.vertexInputState.bindings)
-        vkVertexInputBindingDescriptions.push_back({binding.bindingIndex, (uint32_t)binding.stride, VK_VERTEX_INPUT_RATE_VERTEX});
+        vkVertexInputBindingDescriptions.push_back({binding.bindingIndex, (uint32_t)binding.stride, binding.inputRate == VertexInputRate::PER_INSTANCE ? VK_VERTEX_INPUT_RATE_INSTANCE : VK_VERTEX_INPUT_RATE_VERTEX});
 
     std::vector<VkVertexInputAttributeDescription> vkVertexInputAttributeDescriptions;
     vkVertexInputAttributeDescriptions.reserve(pipelineCI.vertexInputState.attributes.size());
@@ -1040,17 +1482,30 @@ void *GraphicsAPI_Vulkan::CreatePipeline(const PipelineCreateInfo &pipelineCI) {
     GPCI.basePipelineHandle = VK_NULL_HANDLE;
     GPCI.basePipelineIndex = -1;
 
-    VULKAN_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &GPCI, nullptr, &pipeline), "Failed to create Graphics Pipeline.");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VULKAN_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &GPCI, nullptr, &pipeline), "Failed to create Graphics Pipeline.");
+    pipelineCreationMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    pipelineCreationCount++;
     pipelineResources[pipeline] = {pipelineLayout, descSetLayout, renderPass, pipelineCI};
 
     return (void *)pipeline;
 }
 
 void GraphicsAPI_Vulkan::DestroyPipeline(void *&pipeline) {
+    WaitForFrameContexts();
+    ClearDescriptorSetCaches();
     VkPipeline vkPipeline = (VkPipeline)pipeline;
     VkPipelineLayout pipelineLayout = std::get<0>(pipelineResources[vkPipeline]);
     VkDescriptorSetLayout descSetLayout = std::get<1>(pipelineResources[vkPipeline]);
     VkRenderPass renderPass = std::get<2>(pipelineResources[vkPipeline]);
+    for (auto it = framebufferCache.begin(); it != framebufferCache.end();) {
+        if (it->first.renderPass == renderPass) {
+            vkDestroyFramebuffer(device, it->second, nullptr);
+            it = framebufferCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
     vkDestroyRenderPass(device, renderPass, nullptr);
     vkDestroyDescriptorSetLayout(device, descSetLayout, nullptr);
     vkDestroyPipeline(device, vkPipeline, nullptr);
@@ -1059,19 +1514,26 @@ void GraphicsAPI_Vulkan::DestroyPipeline(void *&pipeline) {
 }
 
 void GraphicsAPI_Vulkan::BeginRendering() {
-    VULKAN_CHECK(vkWaitForFences(device, 1, &fence, true, UINT64_MAX), "Failed to wait for Fence");
-    VULKAN_CHECK(vkResetFences(device, 1, &fence), "Failed to reset Fence.")
-
-    // VULKAN_CHECK(vkResetDescriptorPool(device, descriptorPool, VkDescriptorPoolResetFlags(0)), "Failed to rest DescriptorPool")
-    for (const auto &descSet : cmdBufferDescriptorSets[cmdBuffer]) {
-        VULKAN_CHECK(vkFreeDescriptorSets(device, descriptorPool, 1, &descSet), "Failed to free DescriptorSet.");
+    // Move to the next FrameContext and wait for the GPU to finish the last submission that used it.
+    frameContextIndex = (frameContextIndex + 1) % frameContexts.size();
+    FrameContext &frameContext = frameContexts[frameContextIndex];
+    cmdBuffer = frameContext.cmdBuffer;
+
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    VULKAN_CHECK(vkWaitForFences(device, 1, &frameContext.fence, true, UINT64_MAX), "Failed to wait for Fence");
+    if (frameStallReport) {
+        ReportFrameStall(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count());
     }
-    cmdBufferDescriptorSets.erase(cmdBuffer);
+    VULKAN_CHECK(vkResetFences(device, 1, &frameContext.fence), "Failed to reset Fence.")
 
-    for (const VkFramebuffer &framebuffer : cmdBufferFramebuffers[cmdBuffer]) {
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-    }
-    cmdBufferFramebuffers.erase(cmdBuffer);
+    ReadTimestampScopes(frameContext);
+    frameContext.submission = submissionCount++;
+    openTimestampScopes.clear();
+
+    VULKAN_CHECK(vkResetDescriptorPool(device, frameContext.descriptorPool, VkDescriptorPoolResetFlags(0)), "Failed to reset DescriptorPool")
+    frameContext.descriptorSetCache.clear();
+
+    frameContext.transientUniformOffset = 0;
 
     VULKAN_CHECK(vkResetCommandBuffer(cmdBuffer, VkCommandBufferResetFlagBits(0)), "Failed to reset CommandBuffer.");
 
@@ -1082,6 +1544,10 @@ void GraphicsAPI_Vulkan::BeginRendering() {
     beginInfo.pInheritanceInfo = nullptr;
     VULKAN_CHECK(vkBeginCommandBuffer(cmdBuffer, &beginInfo), "Failed to begin CommandBuffer.");
 
+    if (frameContext.timestampQueryPool) {
+        vkCmdResetQueryPool(cmdBuffer, frameContext.timestampQueryPool, 0, 2 * maxTimestampScopes);
+    }
+
     if (currentDesktopSwapchainImage) {
         VkImageMemoryBarrier barrier;
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1102,6 +1568,10 @@ void GraphicsAPI_Vulkan::BeginRendering() {
 }
 
 void GraphicsAPI_Vulkan::EndRendering() {
+    while (!openTimestampScopes.empty()) {
+        EndTimestampScope();
+    }
+
     if (inRenderPass) {
         vkCmdEndRenderPass(cmdBuffer);
         inRenderPass = false;
@@ -1127,6 +1597,9 @@ void GraphicsAPI_Vulkan::EndRendering() {
 
     VULKAN_CHECK(vkEndCommandBuffer(cmdBuffer), "Failed to end CommandBuffer.");
 
+    // Submit any pending staged copies first, so that they complete before this frame reads the buffers.
+    FlushUploads();
+
     VkPipelineStageFlags waitDstStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
@@ -1140,22 +1613,80 @@ void GraphicsAPI_Vulkan::EndRendering() {
     submitInfo.signalSemaphoreCount = submitSemaphore ? 1 : 0;
     submitInfo.pSignalSemaphores = submitSemaphore ? &submitSemaphore : nullptr;
 
-    VULKAN_CHECK(vkQueueSubmit(queue, 1, &submitInfo, fence), "Failed to submit to Queue.");
+    VULKAN_CHECK(vkQueueSubmit(queue, 1, &submitInfo, frameContexts[frameContextIndex].fence), "Failed to submit to Queue.");
+}
+
+void GraphicsAPI_Vulkan::BeginTimestampScope(const char *name) {
+    FrameContext &frameContext = frameContexts[frameContextIndex];
+    uint32_t index = static_cast<uint32_t>(frameContext.timestampScopes.size());
+    if (!frameContext.timestampQueryPool || index >= maxTimestampScopes) {
+        openTimestampScopes.push_back(UINT32_MAX);  // Not measured, but still has to be matched by EndTimestampScope().
+        return;
+    }
+    frameContext.timestampScopes.push_back({name, static_cast<uint32_t>(openTimestampScopes.size()), 2 * index, 2 * index + 1});
+    openTimestampScopes.push_back(index);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameContext.timestampQueryPool, 2 * index);
+}
+
+void GraphicsAPI_Vulkan::EndTimestampScope() {
+    if (openTimestampScopes.empty()) {
+        std::cout << "ERROR: VULKAN: EndTimestampScope() called without a matching BeginTimestampScope()." << std::endl;
+        return;
+    }
+    uint32_t index = openTimestampScopes.back();
+    openTimestampScopes.pop_back();
+    if (index != UINT32_MAX) {
+        FrameContext &frameContext = frameContexts[frameContextIndex];
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameContext.timestampQueryPool, frameContext.timestampScopes[index].endQuery);
+    }
+}
+
+void GraphicsAPI_Vulkan::ReadTimestampScopes(FrameContext &frameContext) {
+    if (frameContext.timestampScopes.empty()) {
+        return;
+    }
+    // The context's fence has signalled, so this doesn't wait. Each query returns its value and its availability.
+    uint32_t queryCount = 2 * static_cast<uint32_t>(frameContext.timestampScopes.size());
+    std::vector<uint64_t> queryResults(2 * queryCount);
+    VkResult result = vkGetQueryPoolResults(device, frameContext.timestampQueryPool, 0, queryCount, queryResults.size() * sizeof(uint64_t), queryResults.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result == VK_SUCCESS || result == VK_NOT_READY) {
+        if (timestampScopeResults.size() > 4096) {
+            timestampScopeResults.clear();  // Nobody is collecting them.
+        }
+        for (const TimestampScope &scope : frameContext.timestampScopes) {
+            if (queryResults[2 * scope.beginQuery + 1] && queryResults[2 * scope.endQuery + 1]) {
+                uint64_t ticks = (queryResults[2 * scope.endQuery] - queryResults[2 * scope.beginQuery]) & timestampMask;
+                timestampScopeResults.push_back({scope.name, scope.depth, frameContext.submission, double(ticks) * timestampPeriod / 1000000.0});
+            }
+        }
+    }
+    frameContext.timestampScopes.clear();
 }
 
 void GraphicsAPI_Vulkan::SetBufferData(void *buffer, size_t offset, size_t size, void *data) {
-    VkBuffer vkBuffer = (VkBuffer)buffer;
-    VkDeviceMemory memory = bufferResources[vkBuffer].first;
-    void *mappedData = nullptr;
-    VULKAN_CHECK(vkMapMemory(device, memory, offset, size, 0, &mappedData), "Can not map Buffer.");
+    char *mappedData = (char *)bufferResources[(VkBuffer)buffer].first.mappedData;
     if (mappedData && data) {
-        memcpy(mappedData, data, size);
+        memcpy(mappedData + offset, data, size);
         // Because the VkDeviceMemory use a heap with properties (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
         // We don't need to use vkFlushMappedMemoryRanges() or vkInvalidateMappedMemoryRanges()
+    } else if (data) {
+        UploadBufferData((VkBuffer)buffer, offset, size, data);
     }
-    vkUnmapMemory(device, memory);
 };
 
+GraphicsAPI::TransientBufferAllocation GraphicsAPI_Vulkan::AllocateTransientUniformData(size_t size) {
+    FrameContext &frameContext = frameContexts[frameContextIndex];
+    size_t offset = Align(frameContext.transientUniformOffset, transientUniformAlignment);
+    if (offset + size > transientUniformSegmentSize) {
+        std::cout << "ERROR: VULKAN: Out of transient uniform memory for this submission." << std::endl;
+        return {nullptr, 0, nullptr};
+    }
+    frameContext.transientUniformOffset = offset + size;
+
+    size_t bufferOffset = transientUniformSegmentSize * frameContextIndex + offset;
+    return {(void *)transientUniformBuffer, bufferOffset, transientUniformMappedData + bufferOffset};
+}
+
 void GraphicsAPI_Vulkan::ClearColor(void *imageView, float r, float g, float b, float a) {
     const ImageViewCreateInfo &imageViewCI = imageViewResources[(VkImageView)imageView];
 
@@ -1242,6 +1773,15 @@ void GraphicsAPI_Vulkan::ClearDepth(void *imageView, float d) {
     vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VkDependencyFlagBits(0), 0, nullptr, 0, nullptr, 1, &imageBarrier);
 }
 
+size_t GraphicsAPI_Vulkan::FramebufferKeyHash::operator()(const FramebufferKey &key) const {
+    size_t hash = std::hash<uint64_t>()((uint64_t)key.renderPass);
+    for (const VkImageView &imageView : key.imageViews) {
+        HashCombine(hash, (uint64_t)imageView);
+    }
+    HashCombine(hash, ((uint64_t)key.width << 32) | key.height);
+    return hash;
+}
+
 void GraphicsAPI_Vulkan::SetRenderAttachments(void **colorViews, size_t colorViewCount, void *depthStencilView, uint32_t width, uint32_t height, void *pipeline) {
     if (inRenderPass) {
         vkCmdEndRenderPass(cmdBuffer);
@@ -1249,27 +1789,29 @@ void GraphicsAPI_Vulkan::SetRenderAttachments(void **colorViews, size_t colorVie
 
     VkRenderPass renderPass = std::get<2>(pipelineResources[(VkPipeline)pipeline]);
 
-    std::vector<VkImageView> vkImageViews;
+    FramebufferKey framebufferKey{renderPass, {}, width, height};
+    framebufferKey.imageViews.reserve(colorViewCount + 1);
     for (size_t i = 0; i < colorViewCount; i++) {
-        vkImageViews.push_back((VkImageView)colorViews[i]);
+        framebufferKey.imageViews.push_back((VkImageView)colorViews[i]);
     }
     if (depthStencilView) {
-        vkImageViews.push_back((VkImageView)depthStencilView);
-    }
-
-    VkFramebuffer framebuffer{};
-    VkFramebufferCreateInfo framebufferCI;
-    framebufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferCI.pNext = nullptr;
-    framebufferCI.flags = 0;
-    framebufferCI.renderPass = renderPass;
-    framebufferCI.attachmentCount = static_cast<uint32_t>(vkImageViews.size());
-    framebufferCI.pAttachments = vkImageViews.data();
-    framebufferCI.width = width;
-    framebufferCI.height = height;
-    framebufferCI.layers = 1;
-    VULKAN_CHECK(vkCreateFramebuffer(device, &framebufferCI, nullptr, &framebuffer), "Failed to create Framebuffer");
-    cmdBufferFramebuffers[cmdBuffer].push_back(framebuffer);
+        framebufferKey.imageViews.push_back((VkImageView)depthStencilView);
+    }
+
+    VkFramebuffer &framebuffer = framebufferCache[framebufferKey];
+    if (framebuffer == VK_NULL_HANDLE) {
+        VkFramebufferCreateInfo framebufferCI;
+        framebufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferCI.pNext = nullptr;
+        framebufferCI.flags = 0;
+        framebufferCI.renderPass = renderPass;
+        framebufferCI.attachmentCount = static_cast<uint32_t>(framebufferKey.imageViews.size());
+        framebufferCI.pAttachments = framebufferKey.imageViews.data();
+        framebufferCI.width = width;
+        framebufferCI.height = height;
+        framebufferCI.layers = 1;
+        VULKAN_CHECK(vkCreateFramebuffer(device, &framebufferCI, nullptr, &framebuffer), "Failed to create Framebuffer");
+    }
 
     VkRenderPassBeginInfo renderPassBegin;
     renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1277,8 +1819,8 @@ void GraphicsAPI_Vulkan::SetRenderAttachments(void **colorViews, size_t colorVie
     renderPassBegin.renderPass = renderPass;
     renderPassBegin.framebuffer = framebuffer;
     renderPassBegin.renderArea.offset = {0, 0};
-    renderPassBegin.renderArea.extent.width = framebufferCI.width;
-    renderPassBegin.renderArea.extent.height = framebufferCI.height;
+    renderPassBegin.renderArea.extent.width = width;
+    renderPassBegin.renderArea.extent.height = height;
     renderPassBegin.clearValueCount = 0;
     renderPassBegin.pClearValues = nullptr;
     vkCmdBeginRenderPass(cmdBuffer, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
@@ -1329,8 +1871,14 @@ void GraphicsAPI_Vulkan::SetDescriptor(const DescriptorInfo &descriptorInfo) {
         VkBuffer buffer = (VkBuffer)descriptorInfo.resource;
         const BufferCreateInfo &bufferCI = bufferResources[buffer].second;
         descBufferInfo.buffer = buffer;
-        descBufferInfo.offset = descriptorInfo.bufferOffset;
         descBufferInfo.range = descriptorInfo.bufferSize;
+        if (descriptorInfo.dynamicOffset) {
+            // The offset is supplied to vkCmdBindDescriptorSets instead, so the written descriptor stays the same across draws.
+            descBufferInfo.offset = 0;
+            dynamicOffsets.push_back({descriptorInfo.bindingIndex, static_cast<uint32_t>(descriptorInfo.bufferOffset)});
+        } else {
+            descBufferInfo.offset = descriptorInfo.bufferOffset;
+        }
     } else if (descriptorInfo.type == DescriptorInfo::Type::IMAGE) {
         VkDescriptorImageInfo &descImageInfo = std::get<2>(writeDescSets.back());
         VkImageView imageView = (VkImageView)descriptorInfo.resource;
@@ -1350,41 +1898,78 @@ void GraphicsAPI_Vulkan::SetDescriptor(const DescriptorInfo &descriptorInfo) {
     }
 }
 
+size_t GraphicsAPI_Vulkan::DescriptorSetKeyHash::operator()(const DescriptorSetKey &key) const {
+    size_t hash = std::hash<uint64_t>()((uint64_t)key.layout);
+    for (const uint64_t &value : key.writes) {
+        HashCombine(hash, value);
+    }
+    return hash;
+}
+
+void GraphicsAPI_Vulkan::ClearDescriptorSetCaches() {
+    // Cached sets may reference a resource that is being destroyed, so none of them can be reused.
+    for (FrameContext &frameContext : frameContexts) {
+        frameContext.descriptorSetCache.clear();
+    }
+}
+
 void GraphicsAPI_Vulkan::UpdateDescriptors() {
     VkPipelineLayout pipelineLayout = std::get<0>(pipelineResources[(VkPipeline)setPipeline]);
     VkDescriptorSetLayout descSetLayout = std::get<1>(pipelineResources[(VkPipeline)setPipeline]);
-    PipelineCreateInfo pipelinCI = std::get<3>(pipelineResources[(VkPipeline)setPipeline]);
-
-    VkDescriptorSet descSet{};
-    VkDescriptorSetAllocateInfo descSetAI;
-    descSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descSetAI.pNext = nullptr;
-    descSetAI.descriptorPool = descriptorPool;
-    descSetAI.descriptorSetCount = 1;
-    descSetAI.pSetLayouts = &descSetLayout;
-    VULKAN_CHECK(vkAllocateDescriptorSets(device, &descSetAI, &descSet), "Failed to allocate DescriptorSet.");
-
-    std::vector<VkWriteDescriptorSet> vkWriteDescSets;
+    FrameContext &frameContext = frameContexts[frameContextIndex];
+
+    // Draws that bind exactly the same resources reuse the set already written for this FrameContext.
+    DescriptorSetKey descSetKey{descSetLayout, {}};
+    descSetKey.writes.reserve(writeDescSets.size() * 8);
     for (auto &writeDescSet : writeDescSets) {
-        VkWriteDescriptorSet &vkWriteDescSet = std::get<0>(writeDescSet);
-        VkDescriptorBufferInfo &vkDescBufferInfo = std::get<1>(writeDescSet);
-        VkDescriptorImageInfo &vkDescImageInfo = std::get<2>(writeDescSet);
-
-        vkWriteDescSet.dstSet = descSet;
-        if (vkDescBufferInfo.buffer) {
-            vkWriteDescSet.pBufferInfo = &vkDescBufferInfo;
-        } else if (vkDescImageInfo.imageView || vkDescImageInfo.sampler) {
-            vkWriteDescSet.pImageInfo = &vkDescImageInfo;
-        } else {
-            continue;
+        const VkWriteDescriptorSet &vkWriteDescSet = std::get<0>(writeDescSet);
+        const VkDescriptorBufferInfo &vkDescBufferInfo = std::get<1>(writeDescSet);
+        const VkDescriptorImageInfo &vkDescImageInfo = std::get<2>(writeDescSet);
+        descSetKey.writes.insert(descSetKey.writes.end(), {(uint64_t)vkWriteDescSet.dstBinding, (uint64_t)vkWriteDescSet.descriptorType,
+                                                          (uint64_t)vkDescBufferInfo.buffer, (uint64_t)vkDescBufferInfo.offset, (uint64_t)vkDescBufferInfo.range,
+                                                          (uint64_t)vkDescImageInfo.imageView, (uint64_t)vkDescImageInfo.sampler, (uint64_t)vkDescImageInfo.imageLayout});
+    }
+
+    VkDescriptorSet &descSet = frameContext.descriptorSetCache[descSetKey];
+    if (descSet == VK_NULL_HANDLE) {
+        VkDescriptorSetAllocateInfo descSetAI;
+        descSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descSetAI.pNext = nullptr;
+        descSetAI.descriptorPool = frameContext.descriptorPool;
+        descSetAI.descriptorSetCount = 1;
+        descSetAI.pSetLayouts = &descSetLayout;
+        VULKAN_CHECK(vkAllocateDescriptorSets(device, &descSetAI, &descSet), "Failed to allocate DescriptorSet.");
+
+        std::vector<VkWriteDescriptorSet> vkWriteDescSets;
+        for (auto &writeDescSet : writeDescSets) {
+            VkWriteDescriptorSet &vkWriteDescSet = std::get<0>(writeDescSet);
+            VkDescriptorBufferInfo &vkDescBufferInfo = std::get<1>(writeDescSet);
+            VkDescriptorImageInfo &vkDescImageInfo = std::get<2>(writeDescSet);
+
+            vkWriteDescSet.dstSet = descSet;
+            if (vkDescBufferInfo.buffer) {
+                vkWriteDescSet.pBufferInfo = &vkDescBufferInfo;
+            } else if (vkDescImageInfo.imageView || vkDescImageInfo.sampler) {
+                vkWriteDescSet.pImageInfo = &vkDescImageInfo;
+            } else {
+                continue;
+            }
+            vkWriteDescSets.push_back(vkWriteDescSet);
         }
-        vkWriteDescSets.push_back(vkWriteDescSet);
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(vkWriteDescSets.size()), vkWriteDescSets.data(), 0, nullptr);
     }
-    vkUpdateDescriptorSets(device, static_cast<uint32_t>(vkWriteDescSets.size()), vkWriteDescSets.data(), 0, nullptr);
     writeDescSets.clear();
 
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descSet, 0, nullptr);
-    cmdBufferDescriptorSets[cmdBuffer].push_back({descSet});
+    // Dynamic offsets are consumed in binding order.
+    std::sort(dynamicOffsets.begin(), dynamicOffsets.end());
+    std::vector<uint32_t> vkDynamicOffsets;
+    vkDynamicOffsets.reserve(dynamicOffsets.size());
+    for (const auto &dynamicOffset : dynamicOffsets) {
+        vkDynamicOffsets.push_back(dynamicOffset.second);
+    }
+    dynamicOffsets.clear();
+
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descSet, static_cast<uint32_t>(vkDynamicOffsets.size()), vkDynamicOffsets.data());
 }
 
 void GraphicsAPI_Vulkan::SetVertexBuffers(void **vertexBuffers, size_t count) {
@@ -1408,6 +1993,20 @@ void GraphicsAPI_Vulkan::DrawIndexed(uint32_t indexCount, uint32_t instanceCount
     vkCmdDrawIndexed(cmdBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 }
 
+void GraphicsAPI_Vulkan::DrawIndexedIndirect(void *indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    if (!stride) {
+        stride = sizeof(DrawIndexedIndirectCommand);
+    }
+    VkBuffer buffer = (VkBuffer)indirectBuffer;
+    if (multiDrawIndirect || drawCount <= 1) {
+        vkCmdDrawIndexedIndirect(cmdBuffer, buffer, offset, drawCount, stride);
+    } else {
+        for (uint32_t i = 0; i < drawCount; i++) {
+            vkCmdDrawIndexedIndirect(cmdBuffer, buffer, offset + (VkDeviceSize)i * stride, 1, stride);
+        }
+    }
+}
+
 void GraphicsAPI_Vulkan::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
     vkCmdDraw(cmdBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
 }
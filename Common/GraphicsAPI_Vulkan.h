@@ -10,8 +10,9 @@
 #if defined(XR_USE_GRAPHICS_API_VULKAN)
 class GraphicsAPI_Vulkan : public GraphicsAPI {
 public:
-    GraphicsAPI_Vulkan();
-    GraphicsAPI_Vulkan(XrInstance m_xrInstance, XrSystemId systemId);
+    // framesInFlight sets how many submissions may be recorded ahead of the GPU. XR_TUTORIAL_VULKAN_FRAMES_IN_FLIGHT overrides it.
+    GraphicsAPI_Vulkan(uint32_t framesInFlight = 1);
+    GraphicsAPI_Vulkan(XrInstance m_xrInstance, XrSystemId systemId, uint32_t framesInFlight = 1);
     ~GraphicsAPI_Vulkan();
 
     virtual void* CreateDesktopSwapchain(const SwapchainCreateInfo& swapchainCI) override;
@@ -61,8 +62,15 @@ public:
     virtual void BeginRendering() override;
     virtual void EndRendering() override;
 
+    virtual uint32_t GetFramesInFlight() override { return static_cast<uint32_t>(frameContexts.size()); }
+    virtual bool DefersCommandExecution() override { return true; }
+    virtual TransientBufferAllocation AllocateTransientUniformData(size_t size) override;
+
     virtual void SetBufferData(void* buffer, size_t offset, size_t size, void* data) override;
 
+    virtual void BeginTimestampScope(const char* name) override;
+    virtual void EndTimestampScope() override;
+
     virtual void ClearColor(void* imageView, float r, float g, float b, float a) override;
     virtual void ClearDepth(void* imageView, float d) override;
 
@@ -77,12 +85,40 @@ public:
     virtual void SetIndexBuffer(void* indexBuffer) override;
     virtual void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0) override;
     virtual void Draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0) override;
+    virtual void DrawIndexedIndirect(void* indirectBuffer, size_t offset, uint32_t drawCount, uint32_t stride = 0) override;
 
 private:
     void LoadPFN_XrFunctions(XrInstance m_xrInstance);
     std::vector<std::string> GetInstanceExtensionsForOpenXR(XrInstance m_xrInstance, XrSystemId systemId);
     std::vector<std::string> GetDeviceExtensionsForOpenXR(XrInstance m_xrInstance, XrSystemId systemId);
 
+    void CreateFrameContexts(uint32_t framesInFlight);
+    void DestroyFrameContexts();
+    void WaitForFrameContexts();
+    void ReportFrameStall(double stallMs);
+    void ClearDescriptorSetCaches();
+
+    // A range of a VkDeviceMemory block handed out by AllocateMemory().
+    struct MemoryAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t poolKey = 0;
+        void* mappedData = nullptr;  // Only set for host visible memory.
+    };
+    MemoryAllocation AllocateMemory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags properties, bool linear);
+    void FreeMemory(const MemoryAllocation& allocation);
+    void DestroyMemoryPools();
+    void LogMemoryStats();
+
+    void CreateUploadResources();
+    void DestroyUploadResources();
+    void UploadBufferData(VkBuffer buffer, size_t offset, size_t size, const void* data);
+    void FlushUploads();
+
+    void CreatePipelineCache();
+    void DestroyPipelineCache();
+
     virtual const std::vector<int64_t> GetSupportedColorSwapchainFormats() override;
     virtual const std::vector<int64_t> GetSupportedDepthSwapchainFormats() override;
 
@@ -93,11 +129,90 @@ private:
     uint32_t queueFamilyIndex = 0xFFFFFFFF;
     uint32_t queueIndex = 0xFFFFFFFF;
     VkQueue queue{};
-    VkFence fence{};
+    bool multiDrawIndirect = false;  // Without it, DrawIndexedIndirect() records one command per draw.
 
     VkCommandPool cmdPool{};
-    VkCommandBuffer cmdBuffer{};
-    VkDescriptorPool descriptorPool;
+
+    // Queried once at device creation and used for every memory type lookup.
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+
+    // Resources are sub-allocated from large VkDeviceMemory blocks. There is one pool of blocks per memory type, and
+    // linear (buffer) and optimal (image) resources use separate pools, so bufferImageGranularity never has to be considered.
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize usedBytes = 0;
+        uint32_t allocationCount = 0;
+        void* mappedData = nullptr;                     // Host visible blocks are mapped once for their whole lifetime.
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;  // Offset to size, sorted so that adjacent ranges can be coalesced.
+    };
+    std::unordered_map<uint32_t, std::vector<MemoryBlock>> memoryPools;  // Keyed by (memoryTypeIndex << 1) | linear.
+    VkDeviceSize memoryBlockSize = 64 * 1024 * 1024;
+
+    // Identifies a descriptor set by its layout and the flattened contents of its writes.
+    struct DescriptorSetKey {
+        VkDescriptorSetLayout layout;
+        std::vector<uint64_t> writes;
+        bool operator==(const DescriptorSetKey& other) const { return layout == other.layout && writes == other.writes; }
+    };
+    struct DescriptorSetKeyHash {
+        size_t operator()(const DescriptorSetKey& key) const;
+    };
+
+    // Each BeginRendering()/EndRendering() pair records into the next FrameContext in the ring, so the CPU only
+    // waits for the GPU when it wraps around to a context whose previous submission is still executing.
+    struct FrameContext {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // Reset wholesale in BeginRendering(), along with the cache of the sets allocated from it.
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        std::unordered_map<DescriptorSetKey, VkDescriptorSet, DescriptorSetKeyHash> descriptorSetCache;
+        size_t transientUniformOffset = 0;  // Bump pointer into this context's segment of transientUniformBuffer.
+        // Two timestamps per scope. The results of the last submission are read once its fence has signalled.
+        VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+        std::vector<TimestampScope> timestampScopes;
+        uint64_t submission = 0;
+    };
+    std::vector<FrameContext> frameContexts;
+    size_t frameContextIndex = 0;
+    VkCommandBuffer cmdBuffer{};  // The command buffer of the current FrameContext.
+
+    void ReadTimestampScopes(FrameContext& frameContext);
+    std::vector<uint32_t> openTimestampScopes;  // Indices into the current FrameContext's timestampScopes.
+    float timestampPeriod = 0.0f;               // Nanoseconds per tick.
+    uint64_t timestampMask = 0;
+    uint64_t submissionCount = 0;
+
+    // One persistently mapped uniform buffer, split into a segment per FrameContext, backs AllocateTransientUniformData().
+    VkBuffer transientUniformBuffer = VK_NULL_HANDLE;
+    char* transientUniformMappedData = nullptr;
+    size_t transientUniformSegmentSize = 1024 * 1024;
+    size_t transientUniformAlignment = 256;
+
+    // STATIC buffers live in device local memory. Their data is copied through a host visible staging buffer, and the copies
+    // are batched into a single transfer submission that is flushed ahead of the next frame's submission.
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    MemoryAllocation stagingAllocation{};
+    VkDeviceSize stagingBufferSize = 4 * 1024 * 1024;
+    VkDeviceSize stagingOffset = 0;
+    VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+    VkFence uploadFence = VK_NULL_HANDLE;
+    bool uploadRecording = false;
+
+    // Pipelines are compiled through a VkPipelineCache that is saved to disk on shutdown and reloaded on the next launch.
+    // The file name carries the device's pipelineCacheUUID and driver version. XR_TUTORIAL_VULKAN_PIPELINE_CACHE_DIR sets
+    // the directory; persistence is disabled on Android, where the working directory isn't writable.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::string pipelineCacheFileName;
+    bool pipelineCacheWarm = false;
+    uint32_t pipelineCreationCount = 0;
+    double pipelineCreationMs = 0.0;
+
+    // Set XR_TUTORIAL_VULKAN_BENCHMARK=1 to periodically report the CPU time spent waiting on frame fences.
+    bool frameStallReport = false;
+    uint32_t frameStallSubmissions = 0;
+    double frameStallTotalMs = 0.0;
+    std::chrono::steady_clock::time_point frameStallPeriodStart;
 
     std::vector<const char*> activeInstanceLayers{};
     std::vector<const char*> activeInstanceExtensions{};
@@ -119,20 +234,33 @@ private:
     VkSemaphore submitSemaphore{};
 
     std::unordered_map<VkImage, VkImageLayout> imageStates;
-    std::unordered_map<VkImage, std::pair<VkDeviceMemory, ImageCreateInfo>> imageResources;
+    std::unordered_map<VkImage, std::pair<MemoryAllocation, ImageCreateInfo>> imageResources;
     std::unordered_map<VkImageView, ImageViewCreateInfo> imageViewResources;
 
-    std::unordered_map<VkBuffer, std::pair<VkDeviceMemory, BufferCreateInfo>> bufferResources;
+    std::unordered_map<VkBuffer, std::pair<MemoryAllocation, BufferCreateInfo>> bufferResources;
 
     std::unordered_map<VkShaderModule, ShaderCreateInfo> shaderResources;
     std::unordered_map<VkPipeline, std::tuple<VkPipelineLayout, VkDescriptorSetLayout, VkRenderPass, PipelineCreateInfo>> pipelineResources;
 
-    std::unordered_map<VkCommandBuffer, std::vector<VkFramebuffer>> cmdBufferFramebuffers;
+    // Framebuffers are reused across frames. Entries are removed when one of their image views or their render pass is destroyed.
+    struct FramebufferKey {
+        VkRenderPass renderPass;
+        std::vector<VkImageView> imageViews;
+        uint32_t width;
+        uint32_t height;
+        bool operator==(const FramebufferKey& other) const {
+            return renderPass == other.renderPass && imageViews == other.imageViews && width == other.width && height == other.height;
+        }
+    };
+    struct FramebufferKeyHash {
+        size_t operator()(const FramebufferKey& key) const;
+    };
+    std::unordered_map<FramebufferKey, VkFramebuffer, FramebufferKeyHash> framebufferCache;
     bool inRenderPass = false;
 
     VkPipeline setPipeline = VK_NULL_HANDLE;
-    std::unordered_map<VkCommandBuffer, std::vector<VkDescriptorSet>> cmdBufferDescriptorSets;
     std::vector<std::tuple<VkWriteDescriptorSet, VkDescriptorBufferInfo, VkDescriptorImageInfo>> writeDescSets;
+    std::vector<std::pair<uint32_t, uint32_t>> dynamicOffsets;  // Binding index and offset of each dynamic buffer descriptor.
 
 };
 #endif
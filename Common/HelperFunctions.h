@@ -8,11 +8,16 @@
 
 // C/C++ Headers
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -120,6 +125,76 @@ inline std::vector<char> ReadBinaryFile(const std::string &filepath, AAssetManag
 
 // XR_DOCS_TAG_END_Helper_Functions1
 
+// 64-bit FNV-1a. Unlike std::hash, the result is the same from one run of the application to the next.
+inline uint64_t HashFNV1a(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Mixes value into hash, for hashing keys made of several handles.
+inline void HashCombine(size_t &hash, uint64_t value) {
+    hash ^= std::hash<uint64_t>()(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+}
+
+// A bounded, lock-free queue between exactly one producer thread and one consumer thread.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+public:
+    bool TryPush(T &&value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_items[tail % Capacity] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool TryPop(T &value) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_items[head % Capacity]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Waits while the queue is full.
+    void Push(T &&value) {
+        for (uint32_t attempt = 0; !TryPush(std::move(value)); attempt++) {
+            Backoff(attempt);
+        }
+    }
+    // Waits for a value. Returns false once the producer has set producerDone and the queue is empty.
+    bool Pop(T &value, const std::atomic<bool> &producerDone) {
+        for (uint32_t attempt = 0; !TryPop(value); attempt++) {
+            if (producerDone.load(std::memory_order_acquire)) {
+                return TryPop(value);
+            }
+            Backoff(attempt);
+        }
+        return true;
+    }
+
+private:
+    // Stages are at most a frame apart, so yield briefly before sleeping rather than blocking on a condition variable.
+    static void Backoff(uint32_t attempt) {
+        if (attempt < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    T m_items[Capacity];
+    std::atomic<size_t> m_head{0};
+    std::atomic<size_t> m_tail{0};
+};
+
 #define XR_DOCS_CHAPTER_1_4 0x14
 
 #define XR_DOCS_CHAPTER_2_1 0x21
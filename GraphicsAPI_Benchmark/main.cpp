@@ -0,0 +1,370 @@
+// Copyright 2023, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// OpenXR Tutorial for Khronos Group
+
+// Renders the Chapter 5 block scene, for two views, offscreen with a headless OpenGL context and reports how quickly
+// the CPU submits its draws. No display, OpenXR runtime or GPU is needed, so it runs with Mesa's llvmpipe:
+//     GraphicsAPI_Benchmark [--frames <count>] [--size <pixels>] [--instanced | --indirect]
+// By default every cuboid is drawn with its own call and its own descriptor and buffer bindings, so the per-draw cost
+// of the API dominates. --instanced draws each view with a single call, as Chapter 5 does. --indirect keeps one draw
+// per cuboid, but issues them all with a single DrawIndexedIndirect() call per view.
+
+#include <GraphicsAPI_OpenGL.h>
+#include <xr_linear_algebra.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+static std::uniform_real_distribution<float> pseudorandom_distribution(0, 1.f);
+static std::mt19937 pseudo_random_generator;
+
+GraphicsAPI *graphicsAPI = nullptr;
+const int64_t colorFormat = GL_RGBA8;
+const uint32_t viewCount = 2;
+uint32_t width = 512;
+uint32_t height = 512;
+
+void *vertexBuffer = nullptr;
+void *indexBuffer = nullptr;
+void *instanceBuffer = nullptr;
+void *uniformBuffer_Camera = nullptr;
+void *uniformBuffer_Normals = nullptr;
+void *indirectBuffer = nullptr;
+void *vertexShader = nullptr, *fragmentShader = nullptr;
+void *pipeline = nullptr;
+
+void *colorImages[viewCount] = {};
+void *colorImageViews[viewCount] = {};
+void *depthImages[viewCount] = {};
+void *depthImageViews[viewCount] = {};
+
+// Matches Chapter 5 and VertexShader_Instanced.glsl.
+struct CameraConstants {
+    XrMatrix4x4f viewProj;
+    XrVector4f pad[12];
+};
+CameraConstants cameraConstants;
+struct CuboidInstance {
+    XrMatrix4x4f model;
+    XrVector4f color;
+};
+XrVector4f normals[6] = {
+    {1.00f, 0.00f, 0.00f, 0},
+    {-1.00f, 0.00f, 0.00f, 0},
+    {0.00f, 1.00f, 0.00f, 0},
+    {0.00f, -1.00f, 0.00f, 0},
+    {0.00f, 0.00f, 1.00f, 0},
+    {0.00f, 0.0f, -1.00f, 0}};
+
+struct Block {
+    XrPosef pose;
+    XrVector3f scale;
+    XrVector3f color;
+};
+std::vector<Block> blocks;
+std::vector<CuboidInstance> cuboidInstances;
+enum class DrawMode {
+    PER_CUBOID,
+    INSTANCED,
+    INDIRECT,
+};
+const float viewHeightM = 1.5f;
+size_t maxCuboidCount = 0;
+size_t framesInFlight = 1;
+
+void CreateResources() {
+    // Vertices for a 1x1x1 meter cube. (Left/Right, Top/Bottom, Front/Back)
+    constexpr XrVector4f vertexPositions[] = {
+        {+0.5f, +0.5f, +0.5f, 1.0f},
+        {+0.5f, +0.5f, -0.5f, 1.0f},
+        {+0.5f, -0.5f, +0.5f, 1.0f},
+        {+0.5f, -0.5f, -0.5f, 1.0f},
+        {-0.5f, +0.5f, +0.5f, 1.0f},
+        {-0.5f, +0.5f, -0.5f, 1.0f},
+        {-0.5f, -0.5f, +0.5f, 1.0f},
+        {-0.5f, -0.5f, -0.5f, 1.0f}};
+
+#define CUBE_FACE(V1, V2, V3, V4, V5, V6) vertexPositions[V1], vertexPositions[V2], vertexPositions[V3], vertexPositions[V4], vertexPositions[V5], vertexPositions[V6],
+
+    XrVector4f cubeVertices[] = {
+        CUBE_FACE(2, 1, 0, 2, 3, 1)  // -X
+        CUBE_FACE(6, 4, 5, 6, 5, 7)  // +X
+        CUBE_FACE(0, 1, 5, 0, 5, 4)  // -Y
+        CUBE_FACE(2, 6, 7, 2, 7, 3)  // +Y
+        CUBE_FACE(0, 4, 6, 0, 6, 2)  // -Z
+        CUBE_FACE(1, 3, 7, 1, 7, 5)  // +Z
+    };
+
+    uint32_t cubeIndices[36] = {
+        0, 1, 2, 3, 4, 5,        // -X
+        6, 7, 8, 9, 10, 11,      // +X
+        12, 13, 14, 15, 16, 17,  // -Y
+        18, 19, 20, 21, 22, 23,  // +Y
+        24, 25, 26, 27, 28, 29,  // -Z
+        30, 31, 32, 33, 34, 35,  // +Z
+    };
+
+    // Create sixty-four cubic blocks, 20cm wide, evenly distributed, and randomly colored, as Chapter 5 does.
+    float scale = 0.2f;
+    XrVector3f center = {0.0f, -0.2f, -0.7f};
+    for (int i = 0; i < 4; i++) {
+        float x = scale * (float(i) - 1.5f) + center.x;
+        for (int j = 0; j < 4; j++) {
+            float y = scale * (float(j) - 1.5f) + center.y;
+            for (int k = 0; k < 4; k++) {
+                float z = scale * (float(k) - 1.5f) + center.z;
+                XrVector3f color = {pseudorandom_distribution(pseudo_random_generator), pseudorandom_distribution(pseudo_random_generator), pseudorandom_distribution(pseudo_random_generator)};
+                blocks.push_back({{{0.0f, 0.0f, 0.0f, 1.0f}, {x, y, z}}, {0.095f, 0.095f, 0.095f}, color});
+            }
+        }
+    }
+    // The blocks, the floor and the table.
+    maxCuboidCount = blocks.size() + 2;
+    cuboidInstances.reserve(maxCuboidCount);
+    framesInFlight = graphicsAPI->GetFramesInFlight();
+
+    vertexBuffer = graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::VERTEX, sizeof(float) * 4, sizeof(cubeVertices), &cubeVertices, GraphicsAPI::BufferCreateInfo::Usage::STATIC});
+    indexBuffer = graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::INDEX, sizeof(uint32_t), sizeof(cubeIndices), &cubeIndices, GraphicsAPI::BufferCreateInfo::Usage::STATIC});
+    instanceBuffer = graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::VERTEX, sizeof(CuboidInstance), sizeof(CuboidInstance) * maxCuboidCount * framesInFlight, nullptr, GraphicsAPI::BufferCreateInfo::Usage::STREAM});
+    uniformBuffer_Camera = graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::UNIFORM, 0, sizeof(CameraConstants) * framesInFlight, nullptr, GraphicsAPI::BufferCreateInfo::Usage::STREAM});
+    uniformBuffer_Normals = graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::UNIFORM, 0, sizeof(normals), &normals, GraphicsAPI::BufferCreateInfo::Usage::STATIC});
+    indirectBuffer = graphicsAPI->CreateBuffer({GraphicsAPI::BufferCreateInfo::Type::INDIRECT, sizeof(GraphicsAPI::DrawIndexedIndirectCommand), sizeof(GraphicsAPI::DrawIndexedIndirectCommand) * maxCuboidCount * framesInFlight, nullptr, GraphicsAPI::BufferCreateInfo::Usage::STREAM});
+
+    std::string vertexSource = ReadTextFile("VertexShader_Instanced.glsl");
+    vertexShader = graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::VERTEX, vertexSource.data(), vertexSource.size()});
+    std::string fragmentSource = ReadTextFile("PixelShader.glsl");
+    fragmentShader = graphicsAPI->CreateShader({GraphicsAPI::ShaderCreateInfo::Type::FRAGMENT, fragmentSource.data(), fragmentSource.size()});
+
+    GraphicsAPI::PipelineCreateInfo pipelineCI;
+    pipelineCI.shaders = {vertexShader, fragmentShader};
+    pipelineCI.vertexInputState.attributes = {{0, 0, GraphicsAPI::VertexType::VEC4, 0, "TEXCOORD"},
+                                              {1, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 0 * sizeof(XrVector4f), "TEXCOORD"},
+                                              {2, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 1 * sizeof(XrVector4f), "TEXCOORD"},
+                                              {3, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 2 * sizeof(XrVector4f), "TEXCOORD"},
+                                              {4, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, model) + 3 * sizeof(XrVector4f), "TEXCOORD"},
+                                              {5, 1, GraphicsAPI::VertexType::VEC4, offsetof(CuboidInstance, color), "TEXCOORD"}};
+    pipelineCI.vertexInputState.bindings = {{0, 0, 4 * sizeof(float), GraphicsAPI::VertexInputRate::PER_VERTEX},
+                                            {1, 0, sizeof(CuboidInstance), GraphicsAPI::VertexInputRate::PER_INSTANCE}};
+    pipelineCI.inputAssemblyState = {GraphicsAPI::PrimitiveTopology::TRIANGLE_LIST, false};
+    pipelineCI.rasterisationState = {false, false, GraphicsAPI::PolygonMode::FILL, GraphicsAPI::CullMode::BACK, GraphicsAPI::FrontFace::COUNTER_CLOCKWISE, false, 0.0f, 0.0f, 0.0f, 1.0f};
+    pipelineCI.multisampleState = {1, false, 1.0f, 0xFFFFFFFF, false, false};
+    pipelineCI.depthStencilState = {true, true, GraphicsAPI::CompareOp::LESS_OR_EQUAL, false, false, {}, {}, 0.0f, 1.0f};
+    pipelineCI.colorBlendState = {false, GraphicsAPI::LogicOp::NO_OP, {{true, GraphicsAPI::BlendFactor::SRC_ALPHA, GraphicsAPI::BlendFactor::ONE_MINUS_SRC_ALPHA, GraphicsAPI::BlendOp::ADD, GraphicsAPI::BlendFactor::ONE, GraphicsAPI::BlendFactor::ZERO, GraphicsAPI::BlendOp::ADD, (GraphicsAPI::ColorComponentBit)15}}, {0.0f, 0.0f, 0.0f, 0.0f}};
+    pipelineCI.colorFormats = {colorFormat};
+    pipelineCI.depthFormat = graphicsAPI->GetDepthFormat();
+    pipelineCI.layout = {{0, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, 0, sizeof(CameraConstants), true},
+                         {1, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX},
+                         {2, nullptr, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::FRAGMENT}};
+    pipeline = graphicsAPI->CreatePipeline(pipelineCI);
+
+    // One color and depth image per view, in place of the swapchain images.
+    for (uint32_t i = 0; i < viewCount; i++) {
+        GraphicsAPI::ImageCreateInfo imageCI;
+        imageCI.dimension = 2;
+        imageCI.width = width;
+        imageCI.height = height;
+        imageCI.depth = 1;
+        imageCI.mipLevels = 1;
+        imageCI.arrayLayers = 1;
+        imageCI.sampleCount = 1;
+        imageCI.format = colorFormat;
+        imageCI.cubemap = false;
+        imageCI.colorAttachment = true;
+        imageCI.depthAttachment = false;
+        imageCI.sampled = false;
+        colorImages[i] = graphicsAPI->CreateImage(imageCI);
+
+        imageCI.format = graphicsAPI->GetDepthFormat();
+        imageCI.colorAttachment = false;
+        imageCI.depthAttachment = true;
+        depthImages[i] = graphicsAPI->CreateImage(imageCI);
+
+        GraphicsAPI::ImageViewCreateInfo imageViewCI;
+        imageViewCI.image = colorImages[i];
+        imageViewCI.type = GraphicsAPI::ImageViewCreateInfo::Type::RTV;
+        imageViewCI.view = GraphicsAPI::ImageViewCreateInfo::View::TYPE_2D;
+        imageViewCI.format = colorFormat;
+        imageViewCI.aspect = GraphicsAPI::ImageViewCreateInfo::Aspect::COLOR_BIT;
+        imageViewCI.baseMipLevel = 0;
+        imageViewCI.levelCount = 1;
+        imageViewCI.baseArrayLayer = 0;
+        imageViewCI.layerCount = 1;
+        colorImageViews[i] = graphicsAPI->CreateImageView(imageViewCI);
+
+        imageViewCI.image = depthImages[i];
+        imageViewCI.type = GraphicsAPI::ImageViewCreateInfo::Type::DSV;
+        imageViewCI.format = graphicsAPI->GetDepthFormat();
+        imageViewCI.aspect = GraphicsAPI::ImageViewCreateInfo::Aspect::DEPTH_BIT;
+        depthImageViews[i] = graphicsAPI->CreateImageView(imageViewCI);
+    }
+}
+
+void DestroyResources() {
+    for (uint32_t i = 0; i < viewCount; i++) {
+        graphicsAPI->DestroyImageView(depthImageViews[i]);
+        graphicsAPI->DestroyImageView(colorImageViews[i]);
+        graphicsAPI->DestroyImage(depthImages[i]);
+        graphicsAPI->DestroyImage(colorImages[i]);
+    }
+    graphicsAPI->DestroyPipeline(pipeline);
+    graphicsAPI->DestroyShader(fragmentShader);
+    graphicsAPI->DestroyShader(vertexShader);
+    graphicsAPI->DestroyBuffer(uniformBuffer_Camera);
+    graphicsAPI->DestroyBuffer(uniformBuffer_Normals);
+    graphicsAPI->DestroyBuffer(indirectBuffer);
+    graphicsAPI->DestroyBuffer(instanceBuffer);
+    graphicsAPI->DestroyBuffer(indexBuffer);
+    graphicsAPI->DestroyBuffer(vertexBuffer);
+}
+
+void RenderCuboid(XrPosef pose, XrVector3f scale, XrVector3f color) {
+    CuboidInstance instance;
+    XrMatrix4x4f_CreateTranslationRotationScale(&instance.model, &pose.position, &pose.orientation, &scale);
+    instance.color = {color.x, color.y, color.z, 1.0f};
+    cuboidInstances.push_back(instance);
+}
+
+// Returns the number of draws issued, whether or not they share a call.
+uint32_t DrawCuboids(uint64_t submission, DrawMode drawMode) {
+    uint32_t instanceCount = static_cast<uint32_t>(cuboidInstances.size());
+    size_t region = submission % framesInFlight;
+    size_t offsetCameraUB = sizeof(CameraConstants) * region;
+    uint32_t firstInstance = static_cast<uint32_t>(maxCuboidCount * region);
+
+    GraphicsAPI::TransientBufferAllocation cameraAllocation = graphicsAPI->AllocateTransientUniformData(sizeof(CameraConstants));
+    if (cameraAllocation.data) {
+        memcpy(cameraAllocation.data, &cameraConstants, sizeof(CameraConstants));
+    } else {
+        cameraAllocation = {uniformBuffer_Camera, offsetCameraUB, nullptr};
+        graphicsAPI->SetBufferData(uniformBuffer_Camera, offsetCameraUB, sizeof(CameraConstants), &cameraConstants);
+    }
+    graphicsAPI->SetBufferData(instanceBuffer, sizeof(CuboidInstance) * firstInstance, sizeof(CuboidInstance) * instanceCount, cuboidInstances.data());
+
+    size_t offsetIndirect = sizeof(GraphicsAPI::DrawIndexedIndirectCommand) * firstInstance;
+    if (drawMode == DrawMode::INDIRECT) {
+        std::vector<GraphicsAPI::DrawIndexedIndirectCommand> commands(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            commands[i] = {36, 1, 0, 0, firstInstance + i};
+        }
+        graphicsAPI->SetBufferData(indirectBuffer, offsetIndirect, sizeof(GraphicsAPI::DrawIndexedIndirectCommand) * instanceCount, commands.data());
+    }
+
+    uint32_t callCount = drawMode == DrawMode::PER_CUBOID ? instanceCount : 1;
+    for (uint32_t i = 0; i < callCount; i++) {
+        graphicsAPI->SetPipeline(pipeline);
+        graphicsAPI->SetDescriptor({0, cameraAllocation.buffer, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, cameraAllocation.offset, sizeof(CameraConstants), true});
+        graphicsAPI->SetDescriptor({1, uniformBuffer_Normals, GraphicsAPI::DescriptorInfo::Type::BUFFER, GraphicsAPI::DescriptorInfo::Stage::VERTEX, false, 0, sizeof(normals)});
+        graphicsAPI->UpdateDescriptors();
+
+        void *vertexBuffers[] = {vertexBuffer, instanceBuffer};
+        graphicsAPI->SetVertexBuffers(vertexBuffers, 2);
+        graphicsAPI->SetIndexBuffer(indexBuffer);
+        if (drawMode == DrawMode::INSTANCED) {
+            graphicsAPI->DrawIndexed(36, instanceCount, 0, 0, firstInstance);
+        } else if (drawMode == DrawMode::INDIRECT) {
+            graphicsAPI->DrawIndexedIndirect(indirectBuffer, offsetIndirect, instanceCount);
+        } else {
+            graphicsAPI->DrawIndexed(36, 1, 0, 0, firstInstance + i);
+        }
+    }
+    cuboidInstances.clear();
+    return drawMode == DrawMode::INSTANCED ? 1 : instanceCount;
+}
+
+int main(int argc, char **argv) {
+    uint32_t frameCount = 1000;
+    uint32_t warmUpFrameCount = 60;
+    DrawMode drawMode = DrawMode::PER_CUBOID;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frameCount = std::max(static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1u);
+        } else if (arg == "--size" && i + 1 < argc) {
+            width = height = std::max(static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1u);
+        } else if (arg == "--instanced") {
+            drawMode = DrawMode::INSTANCED;
+        } else if (arg == "--indirect") {
+            drawMode = DrawMode::INDIRECT;
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--frames <count>] [--size <pixels>] [--instanced | --indirect]" << std::endl;
+            return -1;
+        }
+    }
+
+    GraphicsAPI_OpenGL *graphicsAPI_OpenGL = new GraphicsAPI_OpenGL(true);
+    if (!graphicsAPI_OpenGL->IsContextCreated()) {
+        std::cerr << "ERROR: BENCHMARK: Failed to create a headless OpenGL context." << std::endl;
+        delete graphicsAPI_OpenGL;
+        return -1;
+    }
+    graphicsAPI_OpenGL->SetKeepShadowStateUntilEndFrame(true);  // No runtime shares the headless context.
+    graphicsAPI = graphicsAPI_OpenGL;
+    CreateResources();
+
+    // The two eyes of a viewer standing at the origin, looking down -Z.
+    const float nearZ = 0.05f;
+    const float farZ = 100.0f;
+    const XrFovf fov = {-0.785398f, 0.785398f, 0.785398f, -0.785398f};
+    const XrVector3f eyePositions[viewCount] = {{-0.032f, 0.0f, 0.0f}, {0.032f, 0.0f, 0.0f}};
+
+    uint64_t submission = 0;
+    uint64_t drawCount = 0;
+    double drawRecordingUs = 0.0;
+    std::chrono::steady_clock::time_point start;
+    for (uint32_t frame = 0; frame < warmUpFrameCount + frameCount; frame++) {
+        if (frame == warmUpFrameCount) {
+            glFinish();
+            drawCount = 0;
+            drawRecordingUs = 0.0;
+            start = std::chrono::steady_clock::now();
+        }
+
+        for (uint32_t i = 0; i < viewCount; i++) {
+            graphicsAPI->BeginRendering();
+            graphicsAPI->ClearColor(colorImageViews[i], 0.17f, 0.17f, 0.17f, 1.00f);
+            graphicsAPI->ClearDepth(depthImageViews[i], 1.0f);
+
+            graphicsAPI->SetRenderAttachments(&colorImageViews[i], 1, depthImageViews[i], width, height, pipeline);
+            GraphicsAPI::Viewport viewport = {0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f};
+            GraphicsAPI::Rect2D scissor = {{(int32_t)0, (int32_t)0}, {width, height}};
+            graphicsAPI->SetViewports(&viewport, 1);
+            graphicsAPI->SetScissors(&scissor, 1);
+
+            XrMatrix4x4f proj;
+            XrMatrix4x4f_CreateProjectionFov(&proj, OPENGL, fov, nearZ, farZ);
+            XrMatrix4x4f toView;
+            XrVector3f scale1m{1.0f, 1.0f, 1.0f};
+            XrQuaternionf orientation{0.0f, 0.0f, 0.0f, 1.0f};
+            XrMatrix4x4f_CreateTranslationRotationScale(&toView, &eyePositions[i], &orientation, &scale1m);
+            XrMatrix4x4f view;
+            XrMatrix4x4f_InvertRigidBody(&view, &toView);
+            XrMatrix4x4f_Multiply(&cameraConstants.viewProj, &proj, &view);
+
+            std::chrono::steady_clock::time_point recordingStart = std::chrono::steady_clock::now();
+            // Draw a floor and a "table", then the blocks.
+            RenderCuboid({{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, -viewHeightM, 0.0f}}, {2.0f, 0.1f, 2.0f}, {0.4f, 0.5f, 0.5f});
+            RenderCuboid({{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, -viewHeightM + 0.9f, -0.7f}}, {1.0f, 0.2f, 1.0f}, {0.6f, 0.6f, 0.4f});
+            for (const Block &block : blocks) {
+                RenderCuboid(block.pose, block.scale, block.color);
+            }
+            drawCount += DrawCuboids(submission++, drawMode);
+            drawRecordingUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - recordingStart).count();
+
+            graphicsAPI->EndRendering();
+        }
+        graphicsAPI->EndFrame();
+    }
+    glFinish();
+    double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "BENCHMARK: " << frameCount << " frames of " << viewCount << " views at " << width << "x" << height << (drawMode == DrawMode::INSTANCED ? ", instanced" : drawMode == DrawMode::INDIRECT ? ", one indirect draw per cuboid" : ", one draw per cuboid") << "." << std::endl;
+    std::cout << "BENCHMARK: " << drawCount << " draws in " << elapsedS * 1000.0 << " ms | " << (double)drawCount / elapsedS << " draws/s | " << elapsedS * 1000.0 / frameCount << " ms/frame." << std::endl;
+    std::cout << "BENCHMARK: CPU recording " << drawRecordingUs / (double)drawCount << " us/draw, including instance and uniform uploads." << std::endl;
+
+    DestroyResources();
+    delete graphicsAPI;
+    return 0;
+}
@@ -0,0 +1,30 @@
+// Copyright 2023, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+layout(std140, binding = 0) uniform CameraConstants {
+    mat4 viewProj;
+};
+layout(std140, binding = 1) uniform Normals {
+    vec4 normals[6];
+};
+layout(location = 0) in vec4 a_Positions;
+// Per-instance data: the model matrix as four columns and the color.
+layout(location = 1) in vec4 a_Model0;
+layout(location = 2) in vec4 a_Model1;
+layout(location = 3) in vec4 a_Model2;
+layout(location = 4) in vec4 a_Model3;
+layout(location = 5) in vec4 a_Color;
+layout(location = 0) out flat uvec2 o_TexCoord;
+layout(location = 1) out flat vec3 o_Normal;
+layout(location = 2) out flat vec3 o_Color;
+void main() {
+    mat4 model = mat4(a_Model0, a_Model1, a_Model2, a_Model3);
+    gl_Position = viewProj * model * a_Positions;
+    int face = gl_VertexIndex / 6;
+    o_TexCoord = uvec2(face, 0);
+    o_Normal = (model * normals[face]).xyz;
+    o_Color = a_Color.rgb;
+}